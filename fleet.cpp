@@ -1,66 +1,568 @@
 #include "fleet.h"
+#include "fleet_snapshot.h"
+#include "fleet_columns.h"
+#include "fleet_file.h"
+#include "fleet_journal.h"
+#include "fleet_sink.h"
+#include "fleet_version.h"
+#include <algorithm>
+#include <new>
+#include <thread>
+
+// Counter hook, compiled out unless FLEET_STATS is defined
+#ifdef FLEET_STATS
+#define FLEET_COUNT(field, n) (m_stats.field += (n))
+#else
+#define FLEET_COUNT(field, n) ((void)0)
+#endif
+
+// Empty pool, the first slab is allocated on demand
+ShipPool::ShipPool() {
+    m_free = nullptr;
+    m_next = SLAB_SIZE;
+    m_live = 0;
+    m_allocations = 0;
+}
+
+// Destructor: returns every slab to the heap
+ShipPool::~ShipPool() {
+    clear();
+}
+
+// Hands out a node, preferring recycled ones over fresh slab slots
+Ship* ShipPool::allocate(int id, SHIPTYPE type, STATE state) {
+    void* slot;
+    if (m_free) {
+        slot = m_free;
+        m_free = m_free->m_left;
+    } else {
+        if (m_next == SLAB_SIZE) {
+            m_slabs.push_back(static_cast<Ship*>(::operator new(SLAB_SIZE * sizeof(Ship))));
+            m_next = 0;
+        }
+        slot = m_slabs.back() + m_next++;
+    }
+    m_live++;
+#ifdef FLEET_STATS
+    m_allocations++;
+#endif
+    return new (slot) Ship(id, type, state);
+}
+
+// Pushes a node onto the free list for reuse
+void ShipPool::release(Ship* ship) {
+    if (!ship) return;
+    ship->m_left = m_free;
+    m_free = ship;
+    m_live--;
+}
+
+// Drops all slabs in one sweep; Ship has no resources to destroy
+void ShipPool::clear() {
+    for (size_t i = 0; i < m_slabs.size(); i++)
+        ::operator delete(m_slabs[i]);
+    m_slabs.clear();
+    m_free = nullptr;
+    m_next = SLAB_SIZE;
+    m_live = 0;
+}
+
+// Exchanges the slabs, free lists and counts of two pools
+void ShipPool::swap(ShipPool& other) {
+    m_slabs.swap(other.m_slabs);
+    std::swap(m_free, other.m_free);
+    std::swap(m_next, other.m_next);
+    std::swap(m_live, other.m_live);
+}
+
+// Moves another pool's slabs in front of the newest slab, which keeps
+// serving fresh slots, and chains the two free lists
+void ShipPool::adopt(ShipPool& other) {
+    if (other.m_slabs.empty()) return;
+    m_slabs.insert(m_slabs.empty() ? m_slabs.end() : m_slabs.end() - 1, other.m_slabs.begin(), other.m_slabs.end());
+    while (other.m_free) {
+        Ship* ship = other.m_free;
+        other.m_free = ship->m_left;
+        ship->m_left = m_free;
+        m_free = ship;
+    }
+    m_live += other.m_live;
+    m_allocations += other.m_allocations;
+    other.m_slabs.clear();
+    other.m_next = SLAB_SIZE;
+    other.m_live = 0;
+}
+
+// Index of the lowest/highest set bit of a non-zero word, and the number
+// of set bits of any word
+static inline int lowestBit(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while (!(word & 1)) { word >>= 1; bit++; }
+    return bit;
+#endif
+}
+static inline int bitCount(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word; word &= word - 1) count++;
+    return count;
+#endif
+}
+static inline int highestBit(uint64_t word) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(word);
+#else
+    int bit = 63;
+    while (!(word >> 63)) { word <<= 1; bit--; }
+    return bit;
+#endif
+}
+
+// Subtree size of a possibly empty link
+static inline int sizeOf(const Ship* node) {
+    return node ? node->getSize() : 0;
+}
+
+// Adds delta ships of one type and state to a set of totals
+static inline void tally(FleetTotals& totals, int type, int state, long delta) {
+    totals.ships += delta;
+    totals.byType[type] += delta;
+    totals.byState[state] += delta;
+}
+
+// Adds the counts kept in a subtree to a set of totals
+static inline void tallySubtree(FleetTotals& totals, const Ship* node) {
+    if (!node) return;
+    totals.ships += node->getSize();
+    for (int type = 0; type < SHIPTYPES; type++) totals.byType[type] += node->getTypeCount(static_cast<SHIPTYPE>(type));
+    totals.byState[LOST] += node->getLostCount();
+    totals.byState[ALIVE] += node->getSize() - node->getLostCount();
+}
+
+// Sorts keys of the form (id - MINID) << 32 | tag by ID in linear time with
+// two stable 9-bit counting passes over the 17-bit ID offset; keys with equal
+// IDs keep their input order
+static void radixSortByID(vector<unsigned long long>& keys) {
+    const int BITS = 9, BUCKETS = 1 << BITS;
+    vector<unsigned long long> sorted(keys.size());
+    for (int pass = 0; pass < 2; pass++) {
+        size_t count[BUCKETS + 1] = {0};
+        int shift = 32 + pass * BITS;
+        for (size_t i = 0; i < keys.size(); i++) count[((keys[i] >> shift) & (BUCKETS - 1)) + 1]++;
+        for (int b = 0; b < BUCKETS; b++) count[b + 1] += count[b];
+        for (size_t i = 0; i < keys.size(); i++) sorted[count[(keys[i] >> shift) & (BUCKETS - 1)]++] = keys[i];
+        keys.swap(sorted);
+    }
+}
+
+// Empty table, storage is allocated on the first insert
+DenseTable::DenseTable() {
+    m_count = 0;
+    m_totals = FleetTotals();
+}
+
+// Checks the occupancy bit of an ID
+bool DenseTable::contains(int id) const {
+    if (id < MINID || id > MAXID || m_bits.empty()) return false;
+    int offset = id - MINID;
+    return (m_bits[offset >> 6] >> (offset & 63)) & 1;
+}
+
+// Stores a ship in its slot unless the ID is taken
+bool DenseTable::insert(int id, SHIPTYPE type, STATE state) {
+    if (id < MINID || id > MAXID || contains(id)) return false;
+    if (m_bits.empty()) {
+        m_slots.assign(SLOTS, 0);
+        m_bits.assign((SLOTS + 63) / 64, 0);
+    }
+    int offset = id - MINID;
+    m_slots[offset] = pack(type, state);
+    m_bits[offset >> 6] |= uint64_t(1) << (offset & 63);
+    m_count++;
+    tally(m_totals, type, state, 1);
+    return true;
+}
+
+// Clears the occupancy bit of an ID
+bool DenseTable::remove(int id) {
+    if (!contains(id)) return false;
+    int offset = id - MINID;
+    m_bits[offset >> 6] &= ~(uint64_t(1) << (offset & 63));
+    m_count--;
+    tally(m_totals, m_slots[offset] & 7, m_slots[offset] >> 3, -1);
+    return true;
+}
+
+// Unpacks a stored ship into a standalone Ship
+bool DenseTable::get(int id, Ship& out) const {
+    if (!contains(id)) return false;
+    unsigned char packed = m_slots[id - MINID];
+    out = Ship(id, static_cast<SHIPTYPE>(packed & 7), static_cast<STATE>(packed >> 3));
+    return true;
+}
+
+// Scans forward a word at a time for the next occupied ID
+int DenseTable::next(int id) const {
+    if (id < MINID) id = MINID;
+    if (id > MAXID || m_bits.empty()) return -1;
+    int offset = id - MINID;
+    size_t word = offset >> 6;
+    uint64_t bits = m_bits[word] & (~uint64_t(0) << (offset & 63));
+    while (!bits) {
+        if (++word == m_bits.size()) return -1;
+        bits = m_bits[word];
+    }
+    return MINID + int(word * 64) + lowestBit(bits);
+}
+
+// Scans backward a word at a time for the previous occupied ID
+int DenseTable::prev(int id) const {
+    if (id > MAXID) id = MAXID;
+    if (id < MINID || m_bits.empty()) return -1;
+    int offset = id - MINID;
+    size_t word = offset >> 6;
+    uint64_t bits = m_bits[word] & (~uint64_t(0) >> (63 - (offset & 63)));
+    while (!bits) {
+        if (word-- == 0) return -1;
+        bits = m_bits[word];
+    }
+    return MINID + int(word * 64) + highestBit(bits);
+}
+
+// Counts the occupied IDs below 'id' a word at a time
+size_t DenseTable::rank(int id) const {
+    if (id <= MINID || m_bits.empty()) return 0;
+    if (id > MAXID) return m_count;
+    int offset = id - MINID;
+    size_t word = offset >> 6;
+    size_t count = 0;
+    for (size_t w = 0; w < word; w++) count += bitCount(m_bits[w]);
+    if (offset & 63) count += bitCount(m_bits[word] & (~uint64_t(0) >> (64 - (offset & 63))));
+    return count;
+}
+
+// Skips whole words by their bit counts, then clears bits inside the word
+int DenseTable::select(size_t k) const {
+    if (k >= m_count) return -1;
+    size_t word = 0;
+    for (;; word++) {
+        size_t count = bitCount(m_bits[word]);
+        if (k < count) break;
+        k -= count;
+    }
+    uint64_t bits = m_bits[word];
+    for (; k; k--) bits &= bits - 1;
+    return MINID + int(word * 64) + lowestBit(bits);
+}
+
+// Tallies the stored ships in [lo, hi] from their packed bytes
+FleetTotals DenseTable::totalsInRange(int lo, int hi) const {
+    FleetTotals totals = FleetTotals();
+    for (int id = next(lo); id != -1 && id <= hi; id = next(id + 1))
+        tally(totals, m_slots[id - MINID] & 7, m_slots[id - MINID] >> 3, 1);
+    return totals;
+}
+
+// Repacks a stored ship's type and state and moves it between the totals
+bool DenseTable::retag(int id, SHIPTYPE type, STATE state) {
+    if (!contains(id)) return false;
+    unsigned char& slot = m_slots[id - MINID];
+    tally(m_totals, slot & 7, slot >> 3, -1);
+    tally(m_totals, type, state, 1);
+    slot = pack(type, state);
+    return true;
+}
+
+// Releases the table storage
+void DenseTable::clear() {
+    vector<unsigned char>().swap(m_slots);
+    vector<uint64_t>().swap(m_bits);
+    m_count = 0;
+    m_totals = FleetTotals();
+}
 
 // Default constructor
 Fleet::Fleet() {
     m_root = nullptr;
-    m_type = NONE;
+    useType(NONE);
+    m_version = 0;
+    m_snapshotVersion = 0;
+    m_columnsVersion = 0;
+    m_journal = nullptr;
+    m_shared = false;
+    m_stats = FleetStats();
 }
 
 // Constructor with tree type
 Fleet::Fleet(TREETYPE type) {
     m_root = nullptr;
-    m_type = type;
+    useType(type);
+    m_version = 0;
+    m_snapshotVersion = 0;
+    m_columnsVersion = 0;
+    m_journal = nullptr;
+    m_shared = false;
+    m_stats = FleetStats();
 }
 
-// Destructor: cleans up all Ship nodes
+// Copy constructor: deep copy into this fleet's own pool
+Fleet::Fleet(const Fleet& rhs) {
+    useType(rhs.m_type);
+    m_version = 0;
+    m_snapshotVersion = 0;
+    m_columnsVersion = 0;
+    m_journal = nullptr;
+    m_shared = false;
+    m_stats = FleetStats();
+    m_root = copyTree(rhs.m_root, m_pool);
+    m_dense = rhs.m_dense;
+    m_btree = rhs.m_btree;
+}
+
+// Destructor: the pool releases all Ship nodes, the journal is flushed
 Fleet::~Fleet() {
-    m_root = cleanFleet(m_root); // Helper to delete nodes
-    m_type = NONE;
+    if (m_journal) m_journal->close();
+    releaseNodes();
+    useType(NONE);
 }
 
 // Clears all Ship objects from the fleet
 void Fleet::clear() {
-    m_root = cleanFleet(m_root);
-    m_type = NONE;
+    if (m_journal) journalAll(REMOVESHIP);
+    releaseNodes();
+    m_dense.clear();
+    m_btree.clear();
+    useType(NONE);
+    m_version++;
 }
 
 // Inserts a new Ship, handling ID validation and duplicates
 void Fleet::insert(const Ship& ship) {
-    Ship* newShip = new Ship(ship.m_id, ship.m_type, ship.m_state);
+    if (ship.m_id < MINID || ship.m_id > MAXID)
+        return; // Discard invalid ship
+    if (!insertOne(ship)) return;
+    m_version++;
+    journal(ADDSHIP, ship);
+}
+
+// Removes a Ship by ID, based on tree type
+void Fleet::remove(int id) {
+    if (!removeOne(id)) return;
+    m_version++;
+    journal(REMOVESHIP, Ship(id));
+}
+
+// Logs one change if a journal is attached
+void Fleet::journal(UPDATEOP op, const Ship& ship) {
+    if (m_journal) m_journal->append(op, ship);
+}
+
+// Logs every ship as the same op
+void Fleet::journalAll(UPDATEOP op) {
+    forEachInRange(MINID, MAXID, [this, op](const Ship& ship) {
+        m_journal->append(op, ship);
+    });
+}
+
+// Tree engines unshare the search path from any version before running
+// their algorithm; each engine rejects duplicates during its own descent
+template <bool (Fleet::*Insert)(const Ship&)>
+bool Fleet::insertOwned(const Ship& ship) {
+    if (versionsAlive()) ownPath(&m_root, ship.m_id);
+    return (this->*Insert)(ship);
+}
+
+template <bool (Fleet::*Remove)(int)>
+bool Fleet::removeOwned(int id) {
+    if (versionsAlive()) ownPath(&m_root, id);
+    return (this->*Remove)(id);
+}
+
+// A splay tree lookup splays the ID to the root
+const Ship* Fleet::findSplay(int id) {
+    if (versionsAlive()) ownPath(&m_root, id);
+    m_root = splay(m_root, id);
+    return (m_root && m_root->m_id == id) ? m_root : nullptr;
+}
+
+// The engine of each TREETYPE, in enum order. Only useType() picks one, so
+// an insert, remove or lookup makes a single indirect call, with no switch
+// on the type.
+const Fleet::Engine Fleet::ENGINES[] = {
+    // NONE
+    {&Fleet::insertNone, &Fleet::removeNone, &Fleet::findTree},
+    // BST
+    {&Fleet::insertOwned<&Fleet::insertBST>, &Fleet::removeOwned<&Fleet::removeBST>, &Fleet::findTree},
+    // AVL
+    {&Fleet::insertOwned<&Fleet::insertAVL>, &Fleet::removeOwned<&Fleet::removeAVL>, &Fleet::findTree},
+    // SPLAY
+    {&Fleet::insertOwned<&Fleet::insertSplay>, &Fleet::removeOwned<&Fleet::removeSplay>, &Fleet::findSplay},
+    // DENSE
+    {&Fleet::insertDense, &Fleet::removeDense, &Fleet::findDense},
+    // BTREE
+    {&Fleet::insertBTree, &Fleet::removeBTree, &Fleet::findBTree},
+};
+
+// Finds a Ship by ID with the current engine
+const Ship* Fleet::find(int id) {
+    FLEET_COUNT(lookups, 1);
+#ifdef FLEET_STATS
+    unsigned long before = m_stats.comparisons;
+#endif
+    const Ship* ship = (this->*m_engine->find)(id);
+    FLEET_COUNT(lookupComparisons, m_stats.comparisons - before);
+    return ship;
+}
 
-    if (newShip->m_id < MINID || newShip->m_id > MAXID || findShip(m_root, newShip->m_id)) {
-        delete newShip; // Discard invalid or duplicate ship
+// Checks whether a Ship with this ID is in the fleet
+bool Fleet::contains(int id) {
+    return find(id) != nullptr;
+}
+
+// Batched lookup. Valid probes are radix sorted by ID and then answered in
+// one in-order sweep: a finger stack keeps the path to the last answer, each
+// entry with the exclusive upper bound of its subtree, so the next probe only
+// climbs until its subtree contains it and descends from there. Nearby
+// probes share almost their whole path. The tree is not restructured, so
+// SPLAY fleets are only read here.
+void Fleet::findMany(const int* ids, size_t n, const Ship** out) const {
+    if (isTable()) {
+        m_lookup.resize(n);
+        for (size_t i = 0; i < n; i++)
+            out[i] = tableGet(ids[i], m_lookup[i]) ? &m_lookup[i] : nullptr;
         return;
     }
 
-    // Insert based on tree type
-    if (m_type == BST) {
-        m_root = insertBST(m_root, newShip);
-    } else if (m_type == AVL) {
-        m_root = insertAVL(m_root, newShip);
-    } else if (m_type == SPLAY) {
-        m_root = insertBST(m_root, newShip); // Initial BST insert
-        m_root = splay(m_root, newShip->m_id); // Splay to root
+    // Offset from MINID in the high half, batch position in the low half
+    vector<unsigned long long> probes;
+    probes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        if (ids[i] < MINID || ids[i] > MAXID) out[i] = nullptr;
+        else probes.push_back((static_cast<unsigned long long>(ids[i] - MINID) << 32) | i);
+    }
+    radixSortByID(probes);
+
+    vector<pair<const Ship*, int> > finger; // node, upper bound of its subtree
+    if (m_root) finger.push_back(make_pair(m_root, MAXID + 1));
+    for (size_t i = 0; i < probes.size(); i++) {
+        int id = static_cast<int>(probes[i] >> 32) + MINID;
+        const Ship* found = nullptr;
+        if (!finger.empty()) {
+            while (finger.size() > 1 && id >= finger.back().second) finger.pop_back();
+            const Ship* node = finger.back().first;
+            int bound = finger.back().second;
+            while (true) {
+                if (id == node->m_id) {
+                    found = node;
+                    break;
+                }
+                const Ship* child = node->m_right;
+                if (id < node->m_id) {
+                    child = node->m_left;
+                    bound = node->m_id;
+                }
+                if (!child) break;
+                finger.push_back(make_pair(child, bound));
+                node = child;
+            }
+        }
+        out[probes[i] & 0xffffffffu] = found;
     }
 }
 
-// Removes a Ship by ID, based on tree type
-void Fleet::remove(int id) {
-    if (m_type == BST) {
-        m_root = removeBST(m_root, id);
-    } else if (m_type == AVL) {
-        m_root = removeAVL(m_root, id);
-    } else if (m_type == SPLAY) {
-        removeSplay(id);
+// Publishes an immutable read-optimized snapshot. The last one is handed
+// out again as long as the fleet has not changed since.
+std::shared_ptr<const FleetSnapshot> Fleet::publish() {
+    if (m_snapshot && m_snapshotVersion == m_version) return m_snapshot;
+    struct Collect {
+        vector<int> ids;
+        vector<unsigned char> payload;
+        void open() {}
+        void node(const Ship& ship) {
+            ids.push_back(ship.m_id);
+            payload.push_back(FleetSnapshot::pack(ship.m_type, ship.m_state));
+        }
+        void close() {}
+    } collect;
+    walk(collect);
+    m_snapshot = std::make_shared<const FleetSnapshot>(collect.ids.data(), collect.payload.data(), collect.ids.size());
+    m_snapshotVersion = m_version;
+    return m_snapshot;
+}
+
+// Hands out the columns of the current ships; like publish(), the last ones
+// are handed out again until a change, then rebuilt in one ordered scan
+std::shared_ptr<const FleetColumns> Fleet::columns() {
+    if (m_columns && m_columnsVersion == m_version) return m_columns;
+    vector<int> ids;
+    vector<unsigned char> payload;
+    ids.reserve(size());
+    payload.reserve(size());
+    forEachInRange(MINID, MAXID, [&ids, &payload](const Ship& ship) {
+        ids.push_back(ship.m_id);
+        payload.push_back(FleetSnapshot::pack(ship.m_type, ship.m_state));
+    });
+    m_columns = std::make_shared<const FleetColumns>(ids.data(), payload.data(), ids.size());
+    m_columnsVersion = m_version;
+    return m_columns;
+}
+
+// Saves the ships in ID order as two packed columns
+bool Fleet::save(const char* path) const {
+    vector<int32_t> ids;
+    vector<uint8_t> payload;
+    ids.reserve(size());
+    payload.reserve(size());
+    forEachInRange(MINID, MAXID, [&ids, &payload](const Ship& ship) {
+        ids.push_back(ship.m_id);
+        payload.push_back(FleetSnapshot::pack(ship.m_type, ship.m_state));
+    });
+    return MappedFleet::write(path, ids.data(), payload.data(), ids.size());
+}
+
+// Loads a saved fleet. The records are already sorted and unique, so nodes
+// are carved from the pool in order and linked by buildBalanced directly.
+bool Fleet::load(const char* path) {
+    MappedFleet file;
+    if (!file.open(path)) return false;
+    TREETYPE type = (m_type == NONE) ? AVL : m_type;
+    clear();
+    useType(type);
+    const int32_t* ids = file.ids();
+    const uint8_t* payload = file.payload();
+    if (m_type == DENSE) {
+        for (size_t i = 0; i < file.size(); i++)
+            m_dense.insert(ids[i], static_cast<SHIPTYPE>(payload[i] & 7), static_cast<STATE>(payload[i] >> 3));
+        if (m_journal) journalAll(ADDSHIP);
+        return true;
+    }
+    if (m_type == BTREE) {
+        m_btree.build(ids, payload, file.size());
+        if (m_journal) journalAll(ADDSHIP);
+        return true;
     }
+    vector<Ship*> nodes(file.size());
+    for (size_t i = 0; i < file.size(); i++)
+        nodes[i] = m_pool.allocate(ids[i], static_cast<SHIPTYPE>(payload[i] & 7), static_cast<STATE>(payload[i] >> 3));
+    m_root = buildBalanced(nodes.data(), nodes.size());
+    if (m_journal) journalAll(ADDSHIP);
+    return true;
 }
 
 // Assignment operator for deep copy
 const Fleet& Fleet::operator=(const Fleet& rhs) {
     if (this == &rhs) return *this; // Self-assignment check
     clear();
-    m_type = rhs.m_type;
-    m_root = copyTree(rhs.m_root);
+    useType(rhs.m_type);
+    m_root = copyTree(rhs.m_root, m_pool);
+    m_dense = rhs.m_dense;
+    m_btree = rhs.m_btree;
+    if (m_journal) journalAll(ADDSHIP);
     return *this;
 }
 
@@ -69,111 +571,1229 @@ TREETYPE Fleet::getType() const {
     return m_type;
 }
 
-// Sets the tree type, rebalancing if changing to AVL
+// Returns the number of ships in the fleet
+size_t Fleet::size() const {
+    if (m_type == DENSE) return m_dense.size();
+    if (m_type == BTREE) return m_btree.size();
+    return m_root ? m_root->m_size : 0; // The pool may also hold version nodes
+}
+
+// Sets the tree type, rebalancing if changing to AVL and moving the ships
+// when switching between the tree layouts and the DENSE/BTREE tables
 void Fleet::setType(TREETYPE type) {
-    if (type == AVL && m_type != AVL) {
-        m_root = nodeTransfer(m_root); // Rebalance for AVL
-        m_type = AVL;
-    } else if (type == NONE) {
+    if (type == NONE) {
         clear();
-        m_type = NONE;
-    } else if (type == BST || type == SPLAY) {
-        m_type = type;
+        useType(NONE);
+        return;
+    }
+    if (type == m_type) return;
+    bool fromTable = isTable();
+    if (fromTable) tableToTree(); // Already balanced, valid for every tree type
+    if (type == DENSE || type == BTREE) {
+        treeToTable(type);
+    } else if (type == AVL && !fromTable) {
+        // Rebuild for AVL: relink the existing nodes in order, no reallocation
+        if (versionsAlive()) ownAll();
+        vector<Ship*> nodes;
+        flatten(nodes);
+        m_root = buildBalanced(nodes.data(), nodes.size());
+    }
+    useType(type);
+}
+
+// Bulk load: the batch is radix sorted (first copy of an ID wins) and
+// merged with the tree's nodes in ID order, then the merged run is linked
+// into a perfectly balanced tree. Existing nodes are reused as they are.
+// The version only moves when at least one ship was added.
+void Fleet::bulkLoad(const Ship* ships, size_t n) {
+    if (m_type == NONE || n == 0) return;
+    size_t before = size();
+    // First copy wins, just like a run of ADDSHIP events
+    for (size_t i = 0; m_journal && i < n; i++)
+        if (ships[i].m_id >= MINID && ships[i].m_id <= MAXID) journal(ADDSHIP, ships[i]);
+    if (m_type == DENSE) {
+        for (size_t i = 0; i < n; i++) m_dense.insert(ships[i].m_id, ships[i].m_type, ships[i].m_state);
+        if (size() != before) m_version++;
+        return;
+    }
+    if (m_type == BTREE) {
+        for (size_t i = 0; i < n; i++)
+            if (ships[i].m_id >= MINID && ships[i].m_id <= MAXID) m_btree.insert(ships[i].m_id, ships[i].m_type, ships[i].m_state);
+        if (size() != before) m_version++;
+        return;
+    }
+    vector<unsigned long long> batch;
+    batch.reserve(n);
+    for (size_t i = 0; i < n; i++)
+        if (ships[i].m_id >= MINID && ships[i].m_id <= MAXID)
+            batch.push_back((static_cast<unsigned long long>(ships[i].m_id - MINID) << 32) | i);
+    radixSortByID(batch);
+
+    vector<Ship*> current, merged;
+    if (versionsAlive()) ownAll();
+    flatten(current);
+    merged.reserve(current.size() + batch.size());
+    size_t c = 0;
+    int last = MINID - 1;
+    for (size_t b = 0; b < batch.size(); b++) {
+        const Ship& ship = ships[batch[b] & 0xffffffffu];
+        if (ship.m_id == last) continue; // Repeated within the batch
+        last = ship.m_id;
+        while (c < current.size() && current[c]->m_id < ship.m_id) merged.push_back(current[c++]);
+        if (c < current.size() && current[c]->m_id == ship.m_id) continue; // Already in the fleet
+        merged.push_back(m_pool.allocate(ship.m_id, ship.m_type, ship.m_state));
+    }
+    if (merged.size() == c) return; // Nothing new, the tree stays as it is
+    while (c < current.size()) merged.push_back(current[c++]);
+    m_root = buildBalanced(merged.data(), merged.size());
+    m_version++;
+}
+
+// Batches with at least one event per this many ships are merged with the
+// tree and rebuilt, smaller ones change the tree one ID at a time
+static const size_t REBUILD_SHIPS_PER_EVENT = 4;
+// Below this many events a comparison sort beats the two counting passes
+static const size_t SMALL_BATCH = 256;
+
+// Wraps the ships as ADDSHIP events
+void Fleet::insertMany(const Ship* ships, size_t n) {
+    vector<FleetUpdate> updates(n);
+    for (size_t i = 0; i < n; i++) {
+        updates[i].op = ADDSHIP;
+        updates[i].ship = ships[i];
+    }
+    applyUpdates(updates.data(), n);
+}
+
+// Wraps the IDs as REMOVESHIP events
+void Fleet::removeMany(const int* ids, size_t n) {
+    vector<FleetUpdate> updates(n);
+    for (size_t i = 0; i < n; i++) {
+        updates[i].op = REMOVESHIP;
+        updates[i].ship = Ship(ids[i]);
+    }
+    applyUpdates(updates.data(), n);
+}
+
+// Replays one ID's events (sorted keys, batch order) on its current state
+bool Fleet::foldUpdates(const FleetUpdate* updates, const unsigned long long* keys, size_t n,
+                        bool present, SHIPTYPE& type, STATE& state) {
+    for (size_t i = 0; i < n; i++) {
+        const FleetUpdate& update = updates[keys[i] & 0xffffffffu];
+        if (update.op == REMOVESHIP) {
+            present = false;
+        } else if (update.op == UPSERTSHIP || (update.op == ADDSHIP ? !present : present)) {
+            if (update.op != SETSTATE) type = update.ship.m_type;
+            if (update.op != SETTYPE) state = update.ship.m_state;
+            present = true;
+        }
     }
+    return present;
 }
 
-// Dumps the tree structure (in-order)
+// Applies a batch of events. The valid events are radix sorted by ID, which
+// keeps each ID's events in batch order, and every ID's run is folded into
+// one net change. Small batches make that change with a single tree
+// operation per ID, in ID order so consecutive descents share their upper
+// levels; an ID with one event skips the lookup since the engines already
+// reject duplicates and absent IDs. Large batches are merged with the
+// flattened tree and rebuilt balanced, so no rebalancing is done per event.
+void Fleet::applyUpdates(const FleetUpdate* updates, size_t n) {
+    if (m_type == NONE || n == 0) return;
+    vector<unsigned long long> keys;
+    keys.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        int id = updates[i].ship.m_id;
+        if (id >= MINID && id <= MAXID) keys.push_back((static_cast<unsigned long long>(id - MINID) << 32) | i);
+    }
+    if (keys.empty()) return;
+    // The low half makes keys unique, so a plain sort keeps batch order too
+    if (keys.size() < SMALL_BATCH) std::sort(keys.begin(), keys.end());
+    else radixSortByID(keys);
+
+    bool changed = false;
+    bool rebuild = !isTable() && keys.size() * REBUILD_SHIPS_PER_EVENT >= size();
+    vector<Ship*> current, merged;
+    if (rebuild) {
+        if (versionsAlive()) ownAll();
+        flatten(current);
+        merged.reserve(current.size() + keys.size());
+    }
+    size_t c = 0;
+    for (size_t b = 0, e; b < keys.size(); b = e) {
+        for (e = b + 1; e < keys.size() && (keys[e] >> 32) == (keys[b] >> 32); e++) {}
+        int id = static_cast<int>(keys[b] >> 32) + MINID;
+        if (rebuild) {
+            while (c < current.size() && current[c]->m_id < id) merged.push_back(current[c++]);
+            Ship* node = (c < current.size() && current[c]->m_id == id) ? current[c++] : nullptr;
+            SHIPTYPE type = node ? node->m_type : DEFAULT_TYPE;
+            STATE state = node ? node->m_state : DEFAULT_STATE;
+            bool present = foldUpdates(updates, &keys[b], e - b, node != nullptr, type, state);
+            if (node && !present) {
+                m_pool.release(node);
+                changed = true;
+            } else if (node) {
+                changed |= node->m_type != type || node->m_state != state;
+                node->m_type = type;
+                node->m_state = state;
+                merged.push_back(node);
+            } else if (present) {
+                merged.push_back(m_pool.allocate(id, type, state));
+                changed = true;
+            }
+            continue;
+        }
+        if (e - b == 1) {
+            const FleetUpdate& update = updates[keys[b] & 0xffffffffu];
+            if (update.op == ADDSHIP) changed |= insertOne(update.ship);
+            else if (update.op == REMOVESHIP) changed |= removeOne(id);
+            else if (update.op == UPSERTSHIP) changed |= upsertOne(update.ship);
+            else changed |= retag(update);
+            continue;
+        }
+        Ship ship;
+        bool before;
+        if (isTable()) {
+            before = tableGet(id, ship);
+        } else {
+            const Ship* node = findShip(m_root, id);
+            before = node != nullptr;
+            if (node) ship = *node;
+        }
+        SHIPTYPE type = ship.m_type;
+        STATE state = ship.m_state;
+        bool after = foldUpdates(updates, &keys[b], e - b, before, type, state);
+        if (!before && after) changed |= insertOne(Ship(id, type, state));
+        else if (before && !after) changed |= removeOne(id);
+        else if (after && (type != ship.m_type || state != ship.m_state)) {
+            FleetUpdate update = {RETAGSHIP, Ship(id, type, state)};
+            changed |= retag(update);
+        }
+    }
+    if (rebuild) {
+        while (c < current.size()) merged.push_back(current[c++]);
+        m_root = buildBalanced(merged.data(), merged.size());
+    }
+    if (!changed) return;
+    m_version++;
+    // Sorted order keeps every ID's events in batch order, so replaying
+    // them reaches the same state
+    for (size_t k = 0; m_journal && k < keys.size(); k++) {
+        const FleetUpdate& update = updates[keys[k] & 0xffffffffu];
+        journal(update.op, update.ship);
+    }
+}
+
+// Applies a vector of events
+void Fleet::applyUpdates(const vector<FleetUpdate>& updates) {
+    applyUpdates(updates.data(), updates.size());
+}
+
+// Set operations dispatch on the layouts, see setOperation
+void Fleet::merge(const Fleet& other, int threads) {
+    setOperation(other, UNITE, threads);
+}
+
+void Fleet::intersect(const Fleet& other, int threads) {
+    setOperation(other, INTERSECT, threads);
+}
+
+void Fleet::difference(const Fleet& other, int threads) {
+    setOperation(other, SUBTRACT, threads);
+}
+
+// Subtrees of the other fleet smaller than this are never forked off
+static const int PARALLEL_SET_SHIPS = 16384;
+// A merge or difference with fewer than one ship per this many of ours is
+// done as single inserts/removes, whose constant factor beats the splits
+static const size_t SET_SHIPS_PER_LOOKUP = 16;
+
+// Two AVL fleets recurse over the other fleet's tree, splitting this one
+// around each of its IDs and joining the results back. Everything else
+// merges the two ID orders: the tree layouts relink the kept nodes into a
+// balanced tree, the dense table is changed ship by ship. A journal gets
+// events that replay to the same result.
+void Fleet::setOperation(const Fleet& other, SETOP op, int threads) {
+    if (&other == this) {
+        // A fleet is its own union and intersection
+        if (op == SUBTRACT && size()) {
+            TREETYPE type = m_type;
+            clear();
+            setType(type);
+        }
+        return;
+    }
+    if (m_type == NONE || (op == UNITE && other.size() == 0)) return;
+    size_t before = size();
+    vector<Ship> theirs;
+    vector<int> gone; // journaled ships dropped by an intersection
+    if (m_journal || m_type != AVL || other.m_type != AVL) {
+        theirs.reserve(other.size());
+        other.forEachInRange(MINID, MAXID, [&theirs](const Ship& ship) {theirs.push_back(ship);});
+    }
+    if (m_journal && op == INTERSECT) {
+        size_t t = 0;
+        forEachInRange(MINID, MAXID, [&theirs, &gone, &t](const Ship& ship) {
+            while (t < theirs.size() && theirs[t].m_id < ship.m_id) t++;
+            if (t == theirs.size() || theirs[t].m_id != ship.m_id) gone.push_back(ship.m_id);
+        });
+    }
+
+    if (isTable()) {
+        if (op == UNITE) {
+            for (size_t i = 0; i < theirs.size(); i++) insertOne(theirs[i]);
+        } else if (op == SUBTRACT) {
+            for (size_t i = 0; i < theirs.size(); i++) removeOne(theirs[i].m_id);
+        } else {
+            size_t t = 0;
+            for (int id = tableNext(MINID); id != -1; id = tableNext(id + 1)) {
+                while (t < theirs.size() && theirs[t].m_id < id) t++;
+                if (t == theirs.size() || theirs[t].m_id != id) removeOne(id);
+            }
+        }
+    } else if (op != INTERSECT && other.size() * SET_SHIPS_PER_LOOKUP < before) {
+        if (theirs.empty())
+            other.forEachInRange(MINID, MAXID, [&theirs](const Ship& ship) {theirs.push_back(ship);});
+        for (size_t i = 0; i < theirs.size(); i++) {
+            if (op == UNITE) insertOne(theirs[i]);
+            else removeOne(theirs[i].m_id);
+        }
+    } else if (m_type == AVL && other.m_type == AVL) {
+        if (versionsAlive()) ownAll();
+        if (threads <= 0) threads = std::max(1, int(std::thread::hardware_concurrency()));
+        int forks = 0;
+        while ((2 << forks) <= threads) forks++;
+#ifdef FLEET_STATS
+        forks = 0; // The counters are not shared between threads
+#endif
+        SetScratch scratch;
+        scratch.pool = &m_pool;
+        m_root = setAVL(m_root, other.m_root, op, scratch, forks);
+        for (size_t i = 0; i < scratch.dropped.size(); i++) m_pool.release(scratch.dropped[i]);
+    } else {
+        if (versionsAlive()) ownAll();
+        vector<Ship*> current, merged;
+        flatten(current);
+        merged.reserve(op == UNITE ? current.size() + theirs.size() : current.size());
+        size_t c = 0, t = 0;
+        while (c < current.size() || (op == UNITE && t < theirs.size())) {
+            while (t < theirs.size() && (c == current.size() || theirs[t].m_id < current[c]->m_id)) {
+                if (op == UNITE) merged.push_back(m_pool.allocate(theirs[t].m_id, theirs[t].m_type, theirs[t].m_state));
+                t++;
+            }
+            if (c == current.size()) break;
+            bool shared = t < theirs.size() && theirs[t].m_id == current[c]->m_id;
+            if (shared) t++;
+            if (op == UNITE || shared == (op == INTERSECT)) merged.push_back(current[c]);
+            else m_pool.release(current[c]);
+            c++;
+        }
+        m_root = buildBalanced(merged.data(), merged.size());
+    }
+
+    if (size() == before) return;
+    m_version++;
+    if (!m_journal) return;
+    if (op == INTERSECT) {
+        for (size_t i = 0; i < gone.size(); i++) journal(REMOVESHIP, Ship(gone[i]));
+    } else {
+        for (size_t i = 0; i < theirs.size(); i++) journal(op == UNITE ? ADDSHIP : REMOVESHIP, theirs[i]);
+    }
+}
+
+// One level of the join-based recursion: split this fleet's subtree by the
+// other subtree's root ID, combine the halves with the other root's
+// children and join them, keeping the root's ship if the operation does.
+// Forked halves allocate from their own pool and defer releases, so the
+// threads share no state; the caller adopts their pools afterwards.
+Ship* Fleet::setAVL(Ship* mine, const Ship* theirs, SETOP op, SetScratch& scratch, int forks) {
+    if (!theirs || !mine) {
+        if (op == UNITE && theirs) {
+            // Copies the other subtree, which is already balanced
+            Ship* copy = scratch.pool->allocate(theirs->m_id, theirs->m_type, theirs->m_state);
+            copy->m_left = setAVL(nullptr, theirs->m_left, op, scratch, 0);
+            copy->m_right = setAVL(nullptr, theirs->m_right, op, scratch, 0);
+            copy->m_height = theirs->m_height;
+            copy->copyCounts(*theirs);
+            return copy;
+        }
+        if (op != INTERSECT || !mine) return mine;
+        // Nothing of this subtree is kept
+        setAVL(mine->m_left, nullptr, op, scratch, 0);
+        setAVL(mine->m_right, nullptr, op, scratch, 0);
+        scratch.dropped.push_back(mine);
+        return nullptr;
+    }
+    Ship* left;
+    Ship* right;
+    Ship* found = splitAVL(mine, theirs->m_id, left, right);
+    if (forks > 0 && theirs->m_size >= PARALLEL_SET_SHIPS) {
+        SetScratch forked;
+        forked.pool = &forked.local;
+        std::thread task([&]() {left = setAVL(left, theirs->m_left, op, forked, forks - 1);});
+        right = setAVL(right, theirs->m_right, op, scratch, forks - 1);
+        task.join();
+        scratch.pool->adopt(forked.local);
+        scratch.dropped.insert(scratch.dropped.end(), forked.dropped.begin(), forked.dropped.end());
+    } else {
+        left = setAVL(left, theirs->m_left, op, scratch, forks);
+        right = setAVL(right, theirs->m_right, op, scratch, forks);
+    }
+    if (op == UNITE && !found) found = scratch.pool->allocate(theirs->m_id, theirs->m_type, theirs->m_state);
+    if (op == SUBTRACT && found) {
+        scratch.dropped.push_back(found);
+        found = nullptr;
+    }
+    return found ? joinAVL(left, found, right) : joinAVL(left, right);
+}
+
+// Walks down the taller tree's inner spine to a subtree about as high as
+// the other tree, hangs both below mid there and rebalances on the way
+// back up; each level grows by at most one, so one rotation fixes it
+Ship* Fleet::joinAVL(Ship* left, Ship* mid, Ship* right) {
+    int leftHeight = left ? left->m_height : -1;
+    int rightHeight = right ? right->m_height : -1;
+    if (leftHeight > rightHeight + 1) {
+        left->m_right = joinAVL(left->m_right, mid, right);
+        updateHeight(left);
+        return rebalance(left);
+    }
+    if (rightHeight > leftHeight + 1) {
+        right->m_left = joinAVL(left, mid, right->m_left);
+        updateHeight(right);
+        return rebalance(right);
+    }
+    mid->m_left = left;
+    mid->m_right = right;
+    updateHeight(mid);
+    return mid;
+}
+
+// Joins through the right tree's smallest node
+Ship* Fleet::joinAVL(Ship* left, Ship* right) {
+    if (!left) return right;
+    if (!right) return left;
+    Ship* first;
+    right = splitFirst(right, first);
+    return joinAVL(left, first, right);
+}
+
+// Splits along the search path: subtrees hanging off it to the left are
+// joined into 'left', those to the right into 'right'
+Ship* Fleet::splitAVL(Ship* root, int id, Ship*& left, Ship*& right) {
+    if (!root) {
+        left = right = nullptr;
+        return nullptr;
+    }
+    if (id == root->m_id) {
+        left = root->m_left;
+        right = root->m_right;
+        root->m_left = root->m_right = nullptr; // Relinked by the caller's join
+        return root;
+    }
+    Ship* found;
+    if (id < root->m_id) {
+        Ship* inner;
+        found = splitAVL(root->m_left, id, left, inner);
+        right = joinAVL(inner, root, root->m_right);
+    } else {
+        Ship* inner;
+        found = splitAVL(root->m_right, id, inner, right);
+        left = joinAVL(root->m_left, root, inner);
+    }
+    return found;
+}
+
+// Removes the leftmost node, rebalancing on the way back up
+Ship* Fleet::splitFirst(Ship* root, Ship*& first) {
+    if (!root->m_left) {
+        first = root;
+        Ship* rest = root->m_right;
+        root->m_right = nullptr;
+        updateHeight(root);
+        return rest;
+    }
+    root->m_left = splitFirst(root->m_left, first);
+    updateHeight(root);
+    return rebalance(root);
+}
+
+// Moves every tree node into the DENSE or BTREE table and drops the node
+// slabs. The B+-tree is built bottom-up from the nodes in ID order.
+void Fleet::treeToTable(TREETYPE type) {
+    if (type == DENSE) {
+        vector<const Ship*> pending;
+        if (m_root) pending.push_back(m_root);
+        while (!pending.empty()) {
+            const Ship* ship = pending.back();
+            pending.pop_back();
+            m_dense.insert(ship->m_id, ship->m_type, ship->m_state);
+            if (ship->m_left) pending.push_back(ship->m_left);
+            if (ship->m_right) pending.push_back(ship->m_right);
+        }
+    } else {
+        vector<Ship*> nodes;
+        flatten(nodes);
+        vector<int> ids(nodes.size());
+        vector<unsigned char> payload(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++) {
+            ids[i] = nodes[i]->m_id;
+            payload[i] = static_cast<unsigned char>(nodes[i]->m_state << 3 | nodes[i]->m_type);
+        }
+        m_btree.build(ids.data(), payload.data(), nodes.size());
+    }
+    releaseNodes();
+}
+
+// Collects the tree's nodes with an iterative in-order walk
+void Fleet::flatten(vector<Ship*>& nodes) const {
+    vector<Ship*> stack;
+    Ship* node = m_root;
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->m_left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        nodes.push_back(node);
+        node = node->m_right;
+    }
+}
+
+// Rebuilds a balanced tree from the DENSE or BTREE table in ID order
+void Fleet::tableToTree() {
+    vector<Ship*> nodes;
+    nodes.reserve(size());
+    ShipPool& pool = m_pool;
+    forEachInRange(MINID, MAXID, [&nodes, &pool](const Ship& ship) {
+        nodes.push_back(pool.allocate(ship.m_id, ship.m_type, ship.m_state));
+    });
+    m_root = buildBalanced(nodes.data(), nodes.size());
+    m_dense.clear();
+    m_btree.clear();
+}
+
+// Links nodes sorted by ID into a perfectly balanced tree, middle node
+// first. A range of k nodes always ends up floor(log2 k) high, so heights
+// and subtree sizes are set on the way down; the per-type counts follow in
+// one bottom-up pass.
+Ship* Fleet::buildBalanced(Ship** nodes, size_t n) {
+    struct Frame {
+        size_t lo, hi; // node range of this subtree
+        Ship** link;
+    };
+    Ship* root = nullptr;
+    vector<Frame> frames;
+    vector<Ship*> order; // parents before children
+    order.reserve(n);
+    Frame first = {0, n, &root};
+    if (n) frames.push_back(first);
+    while (!frames.empty()) {
+        Frame frame = frames.back();
+        frames.pop_back();
+        size_t mid = frame.lo + (frame.hi - frame.lo) / 2;
+        Ship* node = nodes[mid];
+        order.push_back(node);
+        int height = 0;
+        for (size_t k = frame.hi - frame.lo; k > 1; k >>= 1) height++;
+        node->m_height = height;
+        node->m_size = int(frame.hi - frame.lo);
+        node->m_left = nullptr;
+        node->m_right = nullptr;
+        *frame.link = node;
+        if (mid > frame.lo) {
+            Frame left = {frame.lo, mid, &node->m_left};
+            frames.push_back(left);
+        }
+        if (mid + 1 < frame.hi) {
+            Frame right = {mid + 1, frame.hi, &node->m_right};
+            frames.push_back(right);
+        }
+    }
+    // Type/state counts depend on the children, so they are summed bottom-up
+    for (size_t i = order.size(); i-- > 0;) pullCounts(order[i]);
+    return root;
+}
+
+// Returns a copy of the operation counters, with the tree shape measured
+// by an O(n) walk
+FleetStats Fleet::stats() const {
+    FleetStats stats = m_stats;
+    stats.allocations = m_pool.allocations();
+    stats.height = -1;
+    if (m_type == BTREE && m_btree.size()) {
+        stats.height = m_btree.height() - 1;
+        stats.depths.assign(m_btree.height(), 0);
+        stats.depths.back() = m_btree.size();
+        return stats;
+    }
+    vector<std::pair<const Ship*, int> > pending;
+    if (m_root) pending.push_back(std::make_pair(m_root, 0));
+    while (!pending.empty()) {
+        const Ship* node = pending.back().first;
+        int depth = pending.back().second;
+        pending.pop_back();
+        if (depth > stats.height) {
+            stats.height = depth;
+            stats.depths.resize(depth + 1);
+        }
+        stats.depths[depth]++;
+        if (node->m_left) pending.push_back(std::make_pair(node->m_left, depth + 1));
+        if (node->m_right) pending.push_back(std::make_pair(node->m_right, depth + 1));
+    }
+    return stats;
+}
+
+// Zeroes the operation counters
+void Fleet::resetStats() {
+    m_stats = FleetStats();
+    m_pool.resetAllocations();
+}
+
+// Dumps the tree structure (in-order) to cout
 void Fleet::dumpTree() const {
-    dump(m_root);
+    dumpTree(cout);
+}
+
+// Dumps the tree structure through a stream sink
+void Fleet::dumpTree(std::ostream& out) const {
+    OstreamSink sink(out);
+    dumpTree(sink);
+}
+
+// Dumps the tree structure into a sink
+void Fleet::dumpTree(FleetSink& sink) const {
+    struct Print {
+        FleetSink& sink;
+        void open() {sink.put('(');}
+        void node(const Ship& ship) {
+            sink.putNumber(ship.m_id);
+            sink.put(':');
+            sink.putNumber(ship.m_height);
+        }
+        void close() {sink.put(')');}
+    } print = {sink};
+    walk(print);
+}
+
+// Exports the ships through a stream sink
+void Fleet::exportShips(std::ostream& out, EXPORTFORMAT format) const {
+    OstreamSink sink(out);
+    exportShips(sink, format);
+}
+
+// Writes one CSV row or JSON object per ship
+void Fleet::exportShips(FleetSink& sink, EXPORTFORMAT format) const {
+    if (format == CSV) sink.put("id,type,state\n");
+    forEachInRange(MINID, MAXID, [&sink, format](const Ship& ship) {
+        if (format == CSV) {
+            sink.putNumber(ship.m_id);
+            sink.put(',');
+            sink.put(ship.getTypeStr());
+            sink.put(',');
+            sink.put(ship.getStateStr());
+            sink.put('\n');
+        } else {
+            sink.put("{\"id\":");
+            sink.putNumber(ship.m_id);
+            sink.put(",\"type\":\"");
+            sink.put(ship.getTypeStr());
+            sink.put("\",\"state\":\"");
+            sink.put(ship.getStateStr());
+            sink.put("\"}\n");
+        }
+    });
+}
+
+// Iterative in-order walk shared by the dump and the snapshot builder. The
+// visitor sees open() when a subtree starts, node() in ID order and close()
+// when the subtree ends. Each tree frame is revisited three times: to open
+// it, to visit the node, and to close it. The DENSE and BTREE tables have no
+// binary shape, so every ship is reported as its own one-node subtree.
+template <class Visitor>
+void Fleet::walk(Visitor& visitor) const {
+    if (isTable()) {
+        Ship ship;
+        for (int id = tableNext(MINID); id != -1; id = tableNext(id + 1)) {
+            tableGet(id, ship);
+            visitor.open();
+            visitor.node(ship);
+            visitor.close();
+        }
+        return;
+    }
+    enum {OPEN, NODE, CLOSE};
+    vector<pair<const Ship*, int> > frames;
+    if (m_root) frames.push_back(make_pair(m_root, OPEN));
+    while (!frames.empty()) {
+        pair<const Ship*, int>& frame = frames.back();
+        const Ship* ship = frame.first;
+        if (frame.second == OPEN) {
+            visitor.open();
+            frame.second = NODE;
+            if (ship->m_left) frames.push_back(make_pair(ship->m_left, OPEN));
+        } else if (frame.second == NODE) {
+            visitor.node(*ship);
+            frame.second = CLOSE;
+            if (ship->m_right) frames.push_back(make_pair(ship->m_right, OPEN));
+        } else {
+            visitor.close();
+            frames.pop_back();
+        }
+    }
+}
+
+// Iterator at the smallest ID
+Fleet::const_iterator Fleet::begin() const {
+    const_iterator it(this);
+    if (isTable()) {
+        int id = tableNext(MINID);
+        if (id != -1) tableGet(id, it.m_ship);
+    } else if (m_root) {
+        it.descend(m_root, true);
+    }
+    return it;
+}
+
+// Past-the-end iterator
+Fleet::const_iterator Fleet::end() const {
+    return const_iterator(this);
+}
+
+// Iterator at the first ship with ID >= id
+Fleet::const_iterator Fleet::lowerBound(int id) const {
+    return seek(id, true);
+}
+
+// Iterator at the first ship with ID > id
+Fleet::const_iterator Fleet::upperBound(int id) const {
+    return seek(id, false);
+}
+
+// Single descent recording the root path; the answer is the last node the
+// descent turned left at, so the path is cut back to it
+Fleet::const_iterator Fleet::seek(int id, bool inclusive) const {
+    const_iterator it(this);
+    if (isTable()) {
+        int found = tableNext(inclusive ? id : id + 1);
+        if (found != -1) tableGet(found, it.m_ship);
+        return it;
+    }
+    size_t keep = 0;
+    const Ship* node = m_root;
+    while (node) {
+        it.m_path.push_back(node);
+        if (inclusive ? node->m_id >= id : node->m_id > id) {
+            keep = it.m_path.size();
+            node = node->m_left;
+        } else {
+            node = node->m_right;
+        }
+    }
+    it.m_path.resize(keep);
+    return it;
+}
+
+// Counts the ships with smaller IDs: every step right skips the left
+// subtree and the node itself
+size_t Fleet::rank(int id) const {
+    if (m_type == DENSE) return m_dense.rank(id);
+    if (m_type == BTREE) return m_btree.rank(id);
+    size_t count = 0;
+    const Ship* node = m_root;
+    while (node) {
+        if (id <= node->m_id) {
+            node = node->m_left;
+        } else {
+            count += sizeOf(node->m_left) + 1;
+            node = node->m_right;
+        }
+    }
+    return count;
+}
+
+// Descends by subtree sizes to the k-th ship, recording the root path so the
+// iterator can page onwards from there
+Fleet::const_iterator Fleet::select(size_t k) const {
+    const_iterator it(this);
+    if (isTable()) {
+        int id = (m_type == DENSE) ? m_dense.select(k) : m_btree.select(k);
+        if (id != -1) tableGet(id, it.m_ship);
+        return it;
+    }
+    if (k >= size()) return it;
+    const Ship* node = m_root;
+    while (true) {
+        it.m_path.push_back(node);
+        size_t left = sizeOf(node->m_left);
+        if (k == left) break;
+        if (k < left) {
+            node = node->m_left;
+        } else {
+            k -= left + 1;
+            node = node->m_right;
+        }
+    }
+    return it;
+}
+
+// Number of ships in [lo, hi] as a difference of two ranks
+size_t Fleet::countInRange(int lo, int hi) const {
+    if (lo < MINID) lo = MINID;
+    if (hi > MAXID) hi = MAXID;
+    if (lo > hi) return 0;
+    return rank(hi + 1) - rank(lo);
+}
+
+// Fleet-wide totals, read off the root's subtree counts
+FleetTotals Fleet::totals() const {
+    if (m_type == DENSE) return m_dense.totals();
+    if (m_type == BTREE) return m_btree.totals();
+    FleetTotals totals = FleetTotals();
+    tallySubtree(totals, m_root);
+    return totals;
+}
+
+// Totals of the ships with ID < id, collected like rank()
+FleetTotals Fleet::totalsBelow(int id) const {
+    FleetTotals totals = FleetTotals();
+    const Ship* node = m_root;
+    while (node) {
+        if (id <= node->m_id) {
+            node = node->m_left;
+        } else {
+            tallySubtree(totals, node->m_left);
+            tally(totals, node->m_type, node->m_state, 1);
+            node = node->m_right;
+        }
+    }
+    return totals;
+}
+
+// Totals of the ships in [lo, hi] as the difference of two prefixes
+FleetTotals Fleet::totalsInRange(int lo, int hi) const {
+    if (lo < MINID) lo = MINID;
+    if (hi > MAXID) hi = MAXID;
+    FleetTotals totals = FleetTotals();
+    if (lo > hi) return totals;
+    if (m_type == DENSE) return m_dense.totalsInRange(lo, hi);
+    if (m_type == BTREE) return m_btree.totalsInRange(lo, hi);
+    totals = totalsBelow(hi + 1);
+    FleetTotals below = totalsBelow(lo);
+    totals.ships -= below.ships;
+    for (int type = 0; type < SHIPTYPES; type++) totals.byType[type] -= below.byType[type];
+    for (int state = 0; state < 2; state++) totals.byState[state] -= below.byState[state];
+    return totals;
+}
+
+// Plain descent that records every link down to the ship
+Ship* Fleet::locate(int id) {
+    m_path.clear();
+    Ship** link = &m_root;
+    while (*link && (*link)->m_id != id) {
+        FLEET_COUNT(comparisons, 1);
+        m_path.push_back(link);
+        link = (id < (*link)->m_id) ? &(*link)->m_left : &(*link)->m_right;
+    }
+    if (*link) m_path.push_back(link);
+    return *link;
+}
+
+// Moves the ship between the counts of every subtree on its root path
+void Fleet::retagPath(Ship* node, SHIPTYPE type, STATE state) {
+    if (type == node->m_type && state == node->m_state) return;
+    for (size_t i = 0; i < m_path.size(); i++) {
+        addCounts(*m_path[i], node->m_type, node->m_state, -1);
+        addCounts(*m_path[i], type, state, 1);
+    }
+    node->m_type = type;
+    node->m_state = state;
+}
+
+// Changes a stored ship's type and/or state as the event asks
+bool Fleet::retag(const FleetUpdate& update) {
+    int id = update.ship.m_id;
+    if (isTable()) {
+        Ship ship;
+        if (!tableGet(id, ship)) return false;
+        SHIPTYPE type = update.op == SETSTATE ? ship.m_type : update.ship.m_type;
+        STATE state = update.op == SETTYPE ? ship.m_state : update.ship.m_state;
+        return (m_type == DENSE) ? m_dense.retag(id, type, state) : m_btree.retag(id, type, state);
+    }
+    if (versionsAlive()) ownPath(&m_root, id);
+    Ship* node = locate(id);
+    if (!node) return false;
+    retagPath(node, update.op == SETSTATE ? node->m_type : update.ship.m_type,
+              update.op == SETTYPE ? node->m_state : update.ship.m_state);
+    return true;
+}
+
+// Insert whose duplicate check doubles as the lookup for the overwrite: a
+// failed BST/AVL insert leaves the found ship's ancestors in m_path, and a
+// failed SPLAY insert leaves the ship at the root
+bool Fleet::upsertOne(const Ship& ship) {
+    if (insertOne(ship)) return true;
+    if (m_type == DENSE) return m_dense.retag(ship.m_id, ship.m_type, ship.m_state);
+    if (m_type == BTREE) return m_btree.retag(ship.m_id, ship.m_type, ship.m_state);
+    Ship** link = &m_root;
+    if (m_type == SPLAY) {
+        m_path.clear();
+    } else if (!m_path.empty()) {
+        Ship* parent = *m_path.back();
+        link = (ship.m_id < parent->m_id) ? &parent->m_left : &parent->m_right;
+    }
+    m_path.push_back(link);
+    retagPath(*link, ship.m_type, ship.m_state);
+    return true;
+}
+
+// Sets a stored ship's state in place
+bool Fleet::updateState(int id, STATE state) {
+    FleetUpdate update = {SETSTATE, Ship(id, DEFAULT_TYPE, state)};
+    if (!retag(update)) return false;
+    m_version++;
+    journal(update.op, update.ship);
+    return true;
+}
+
+// Sets a stored ship's type in place
+bool Fleet::updateType(int id, SHIPTYPE type) {
+    FleetUpdate update = {SETTYPE, Ship(id, type)};
+    if (!retag(update)) return false;
+    m_version++;
+    journal(update.op, update.ship);
+    return true;
+}
+
+// Inserts a ship or overwrites the stored one's type and state
+void Fleet::upsert(const Ship& ship) {
+    if (ship.m_id < MINID || ship.m_id > MAXID) return;
+    if (!upsertOne(ship)) return;
+    m_version++;
+    journal(UPSERTSHIP, ship);
 }
 
-// Recursive helper for in-order tree dump
-void Fleet::dump(Ship* aShip) const {
-    if (aShip != nullptr) {
-        cout << "(";
-        dump(aShip->m_left);
-        cout << aShip->m_id << ":" << aShip->m_height;
-        dump(aShip->m_right);
-        cout << ")";
+// Pushes a node followed by its chain of left (or right) children
+void Fleet::const_iterator::descend(const Ship* node, bool leftmost) {
+    while (node) {
+        m_path.push_back(node);
+        node = leftmost ? node->m_left : node->m_right;
     }
 }
 
-// Recursive helper to deallocate all nodes in a tree
-Ship* Fleet::cleanFleet(Ship* theRoot) {
-    if (!theRoot) return nullptr;
-    theRoot->m_left = cleanFleet(theRoot->m_left);
-    theRoot->m_right = cleanFleet(theRoot->m_right);
-    delete theRoot;
-    return nullptr; // Ensure pointer is nullified
+// Moves to the in-order successor: the leftmost node of the right subtree,
+// or else the nearest ancestor whose left subtree we are leaving
+Fleet::const_iterator& Fleet::const_iterator::operator++() {
+    if (m_fleet->isTable()) {
+        int id = m_fleet->tableNext(m_ship.m_id + 1);
+        if (id == -1) m_ship = Ship();
+        else m_fleet->tableGet(id, m_ship);
+        return *this;
+    }
+    const Ship* node = m_path.back();
+    if (node->m_right) {
+        descend(node->m_right, true);
+        return *this;
+    }
+    m_path.pop_back();
+    while (!m_path.empty() && m_path.back()->m_right == node) {
+        node = m_path.back();
+        m_path.pop_back();
+    }
+    return *this;
+}
+
+// Moves to the in-order predecessor, mirroring operator++
+Fleet::const_iterator& Fleet::const_iterator::operator--() {
+    if (m_fleet->isTable()) {
+        int id = m_fleet->tablePrev(m_ship.m_id == DEFAULT_ID ? MAXID : m_ship.m_id - 1);
+        if (id == -1) m_ship = Ship();
+        else m_fleet->tableGet(id, m_ship);
+        return *this;
+    }
+    if (m_path.empty()) {
+        descend(m_fleet->m_root, false);
+        return *this;
+    }
+    const Ship* node = m_path.back();
+    if (node->m_left) {
+        descend(node->m_left, false);
+        return *this;
+    }
+    m_path.pop_back();
+    while (!m_path.empty() && m_path.back()->m_left == node) {
+        node = m_path.back();
+        m_path.pop_back();
+    }
+    return *this;
+}
+
+// Iterators are equal when they stand on the same ship of the same fleet
+bool Fleet::const_iterator::operator==(const const_iterator& rhs) const {
+    if (m_fleet != rhs.m_fleet) return false;
+    if (m_fleet && m_fleet->isTable()) return m_ship.m_id == rhs.m_ship.m_id;
+    return (m_path.empty() ? nullptr : m_path.back()) == (rhs.m_path.empty() ? nullptr : rhs.m_path.back());
 }
 
 // Finds a Ship node by ID
 Ship* Fleet::findShip(Ship* node, int id) {
-    if (!node) return nullptr;
-    if (id == node->m_id) return node;
-    return (id < node->m_id) ? findShip(node->m_left, id) : findShip(node->m_right, id);
+    while (node) {
+        FLEET_COUNT(comparisons, 1);
+        if (id == node->m_id) return node;
+        node = (id < node->m_id) ? node->m_left : node->m_right;
+    }
+    return nullptr;
 }
 
 // Finds the minimum node in a subtree
 Ship* Fleet::findMin(Ship* node) {
     if (!node) return nullptr;
-    return (node->m_left == nullptr) ? node : findMin(node->m_left);
+    while (node->m_left) node = node->m_left;
+    return node;
 }
 
-// Updates a node's height based on its children's heights
+// Updates a node's height and subtree size based on its children
 void Fleet::updateHeight(Ship* node) {
     if (!node) return;
     int leftHeight = (node->m_left) ? node->m_left->m_height : -1;
     int rightHeight = (node->m_right) ? node->m_right->m_height : -1;
     node->m_height = std::max(leftHeight, rightHeight) + 1;
+    pullCounts(node);
 }
 
-// Removes a node from a BST
-Ship* Fleet::removeBST(Ship* root, int id) {
-    if (root == nullptr) return nullptr;
+// Recomputes a node's subtree size and type/state counts from its children
+void Fleet::pullCounts(Ship* node) {
+    node->initCounts();
+    node->m_size = 1;
+    for (int side = 0; side < 2; side++) {
+        const Ship* child = side ? node->m_right : node->m_left;
+        if (!child) continue;
+        node->m_size += child->m_size;
+        for (int type = 0; type < SHIPTYPES; type++) node->m_typeCount[type] += child->m_typeCount[type];
+        node->m_lostCount += child->m_lostCount;
+    }
+}
 
-    if (id < root->m_id) {
-        root->m_left = removeBST(root->m_left, id);
-    } else if (id > root->m_id) {
-        root->m_right = removeBST(root->m_right, id);
-    } else { // Node to be deleted
-        if (root->m_left == nullptr) {
-            Ship* temp = root->m_right;
-            delete root;
-            root = temp;
-        } else if (root->m_right == nullptr) {
-            Ship* temp = root->m_left;
-            delete root;
-            root = temp;
-        } else {
-            Ship* minRight = findMin(root->m_right);
-            root->m_id = minRight->m_id; // Copy successor's data
-            root->m_state = minRight->m_state;
-            root->m_right = removeBST(root->m_right, minRight->m_id); // Remove successor
+// Adds (or with a negative delta removes) ships of one type and state to a
+// subtree's size and counts
+void Fleet::addCounts(Ship* node, SHIPTYPE type, STATE state, int delta) {
+    node->m_size += delta;
+    node->m_typeCount[type] += delta;
+    if (state == LOST) node->m_lostCount += delta;
+}
+
+// Unlinks the node with 'id' and returns it to the pool. A node with two
+// children is replaced by its in-order successor, which is spliced into its
+// place so that no ship data moves between nodes. On return m_path holds the
+// links from the root down to the lowest changed node, ready for retracing;
+// every subtree on it lost one ship, so their sizes and counts are already
+// decremented and retracing may stop early on an unchanged height.
+bool Fleet::unlinkNode(int id) {
+    m_path.clear();
+    Ship** link = &m_root;
+    while (*link) {
+        FLEET_COUNT(comparisons, 1);
+        if (id == (*link)->m_id) break;
+        m_path.push_back(link);
+        link = (id < (*link)->m_id) ? &(*link)->m_left : &(*link)->m_right;
+    }
+    Ship* node = *link;
+    if (!node) return false;
+
+    // Subtrees on the path below index 'moved' lost the successor, not the node
+    size_t moved = m_path.size();
+    Ship* succ = nullptr;
+    if (!node->m_left) {
+        *link = node->m_right;
+    } else if (!node->m_right) {
+        *link = node->m_left;
+    } else {
+        size_t nodeDepth = m_path.size();
+        m_path.push_back(link);
+        if (m_shared) ownPath(&node->m_right, id); // The successor's path
+        Ship** succLink = &node->m_right;
+        while ((*succLink)->m_left) {
+            m_path.push_back(succLink);
+            succLink = &(*succLink)->m_left;
         }
+        succ = *succLink;
+        *succLink = succ->m_right;
+        succ->m_left = node->m_left;
+        succ->m_right = node->m_right;
+        succ->m_height = node->m_height; // So retracing sees the old subtree height
+        succ->copyCounts(*node);
+        *link = succ;
+        // The first link below the removed node lived inside it
+        if (m_path.size() > nodeDepth + 1) m_path[nodeDepth + 1] = &succ->m_right;
+        moved = nodeDepth + 1;
     }
-    if (root) updateHeight(root);
-    return root;
+    for (size_t i = 0; i < m_path.size(); i++) {
+        const Ship* gone = (i < moved) ? node : succ;
+        addCounts(*m_path[i], gone->m_type, gone->m_state, -1);
+    }
+    m_pool.release(node);
+    return true;
 }
 
-// Inserts a node into a BST
-Ship* Fleet::insertBST(Ship* root, Ship* node) {
-    if (!root) return node;
-    if (node->m_id < root->m_id)
-        root->m_left = insertBST(root->m_left, node);
-    else
-        root->m_right = insertBST(root->m_right, node);
-    updateHeight(root);
-    return root;
+// Removes a node from a BST, fixing heights along the retraced path
+bool Fleet::removeBST(int id) {
+    if (!unlinkNode(id)) return false;
+    for (size_t i = m_path.size(); i-- > 0;) {
+        Ship* node = *m_path[i];
+        int before = node->m_height;
+        updateHeight(node);
+        if (node->m_height == before) break;
+    }
+    return true;
 }
 
-// Deep copies a tree structure
-Ship* Fleet::copyTree(Ship* root) {
-    if (!root) return nullptr;
-    Ship* newRoot = new Ship(root->m_id, root->m_type, root->m_state);
-    newRoot->m_height = root->m_height;
-    newRoot->m_left = copyTree(root->m_left);
-    newRoot->m_right = copyTree(root->m_right);
+// Inserts into a BST in one descent: the walk that finds the empty link
+// also detects a duplicate, and the node is only allocated afterwards
+bool Fleet::insertBST(const Ship& ship) {
+    m_path.clear();
+    Ship** link = &m_root;
+    while (*link) {
+        FLEET_COUNT(comparisons, 1);
+        if (ship.m_id == (*link)->m_id) return false;
+        m_path.push_back(link);
+        link = (ship.m_id < (*link)->m_id) ? &(*link)->m_left : &(*link)->m_right;
+    }
+    *link = m_pool.allocate(ship.m_id, ship.m_type, ship.m_state);
+    for (size_t i = 0; i < m_path.size(); i++) addCounts(*m_path[i], ship.m_type, ship.m_state, 1);
+
+    // Fix heights bottom-up, stopping once an ancestor is unchanged
+    for (size_t i = m_path.size(); i-- > 0;) {
+        Ship* node = *m_path[i];
+        int before = node->m_height;
+        updateHeight(node);
+        if (node->m_height == before) break;
+    }
+    return true;
+}
+
+// Drains the graveyard: roots queued by dropped versions release their
+// nodes here, on the writer. The live count is read first, as a version
+// queues its root before it stops counting.
+bool Fleet::versionsAlive() {
+    if (!m_versions) return m_shared = false;
+    size_t live = m_versions->live;
+    if (m_versions->pending) {
+        vector<Ship*> roots;
+        {
+            std::lock_guard<std::mutex> guard(m_versions->lock);
+            roots.swap(m_versions->graveyard);
+            m_versions->pending = false;
+        }
+        for (size_t i = 0; i < roots.size(); i++) dropRef(roots[i]);
+    }
+    return m_shared = (live != 0);
+}
+
+// Copies a shared node; the copy holds the same children, which become
+// shared in turn, so copying spreads down a path one node at a time
+void Fleet::unshare(Ship** link) {
+    Ship* node = *link;
+    if (!node || node->m_refs == 1) return;
+    Ship* copy = m_pool.allocate(node->m_id, node->m_type, node->m_state);
+    copy->m_left = node->m_left;
+    copy->m_right = node->m_right;
+    copy->m_height = node->m_height;
+    copy->copyCounts(*node);
+    if (copy->m_left) copy->m_left->m_refs++;
+    if (copy->m_right) copy->m_right->m_refs++;
+    node->m_refs--;
+    *link = copy;
+}
+
+// Unshares the search path of id, including the ship itself
+void Fleet::ownPath(Ship** link, int id) {
+    while (*link) {
+        unshare(link);
+        Ship* node = *link;
+        if (id == node->m_id) return;
+        link = (id < node->m_id) ? &node->m_left : &node->m_right;
+    }
+}
+
+// Unshares every node, parents first. A private node may still have shared
+// descendants, so the whole tree is visited.
+void Fleet::ownAll() {
+    vector<Ship**> links;
+    if (m_root) links.push_back(&m_root);
+    while (!links.empty()) {
+        Ship** link = links.back();
+        links.pop_back();
+        unshare(link);
+        if ((*link)->m_left) links.push_back(&(*link)->m_left);
+        if ((*link)->m_right) links.push_back(&(*link)->m_right);
+    }
+}
+
+// Releases a subtree top-down, stopping at nodes that are still held
+void Fleet::dropRef(Ship* root) {
+    vector<Ship*> pending;
+    if (root) pending.push_back(root);
+    while (!pending.empty()) {
+        Ship* node = pending.back();
+        pending.pop_back();
+        if (--node->m_refs) continue;
+        if (node->m_left) pending.push_back(node->m_left);
+        if (node->m_right) pending.push_back(node->m_right);
+        m_pool.release(node);
+    }
+}
+
+// Frees the tree at once. Live versions may still read the pool's nodes,
+// so then the slabs move into their state, which frees them with the last
+// version, and the next snapshot starts a new state.
+void Fleet::releaseNodes() {
+    if (m_versions && versionsAlive()) {
+        m_pool.swap(m_versions->retired);
+        m_versions.reset();
+        m_shared = false;
+    }
+    m_pool.clear();
+    m_root = nullptr;
+}
+
+// Shares the current tree with a new version in O(1). DENSE and BTREE
+// fleets build the version's tree in a state of its own.
+std::shared_ptr<const FleetVersion> Fleet::snapshot() {
+    if (isTable()) {
+        std::shared_ptr<FleetVersionState> state = std::make_shared<FleetVersionState>();
+        vector<Ship*> nodes;
+        nodes.reserve(size());
+        ShipPool& pool = state->retired;
+        forEachInRange(MINID, MAXID, [&nodes, &pool](const Ship& ship) {
+            nodes.push_back(pool.allocate(ship.m_id, ship.m_type, ship.m_state));
+        });
+        state->live++;
+        return std::shared_ptr<const FleetVersion>(new FleetVersion(buildBalanced(nodes.data(), nodes.size()), state));
+    }
+    if (!m_versions) m_versions = std::make_shared<FleetVersionState>();
+    if (m_root) m_root->m_refs++;
+    m_versions->live++;
+    m_shared = true;
+    return std::shared_ptr<const FleetVersion>(new FleetVersion(m_root, m_versions));
+}
+
+// Deep copies a tree structure, preorder with an explicit stack
+Ship* Fleet::copyTree(const Ship* root, ShipPool& pool) {
+    Ship* newRoot = nullptr;
+    vector<pair<const Ship*, Ship**> > pending;
+    if (root) pending.push_back(make_pair(root, &newRoot));
+    while (!pending.empty()) {
+        const Ship* src = pending.back().first;
+        Ship** dst = pending.back().second;
+        pending.pop_back();
+        Ship* copy = pool.allocate(src->m_id, src->m_type, src->m_state);
+        copy->m_height = src->m_height;
+        copy->copyCounts(*src);
+        *dst = copy;
+        if (src->m_right) pending.push_back(make_pair(src->m_right, &copy->m_right));
+        if (src->m_left) pending.push_back(make_pair(src->m_left, &copy->m_left));
+    }
     return newRoot;
 }
 
@@ -184,34 +1804,73 @@ int Fleet::BalanceFactor(Ship* root) {
     return (leftHeight - rightHeight);
 }
 
-// Inserts a node into an AVL tree, performing rotations to maintain balance
-Ship* Fleet::insertAVL(Ship* root, Ship* newElement) {
-    if (!root) return newElement;
-    if (newElement->m_id < root->m_id)
-        root->m_left = insertAVL(root->m_left, newElement);
-    else
-        root->m_right = insertAVL(root->m_right, newElement);
+// Inserts into an AVL tree in one descent, then retraces the recorded
+// links to update heights and apply at most one (double) rotation
+bool Fleet::insertAVL(const Ship& ship) {
+    int id = ship.m_id;
+    m_path.clear();
+    Ship** link = &m_root;
+    while (*link) {
+        FLEET_COUNT(comparisons, 1);
+        if (id == (*link)->m_id) return false;
+        m_path.push_back(link);
+        link = (id < (*link)->m_id) ? &(*link)->m_left : &(*link)->m_right;
+    }
+    *link = m_pool.allocate(ship.m_id, ship.m_type, ship.m_state);
+    // Every ancestor gains one ship, even above where retracing stops
+    for (size_t i = 0; i < m_path.size(); i++) addCounts(*m_path[i], ship.m_type, ship.m_state, 1);
 
-    updateHeight(root); // Update height
+    for (size_t i = m_path.size(); i-- > 0;) {
+        Ship** slot = m_path[i];
+        Ship* root = *slot;
+        int before = root->m_height;
+        updateHeight(root);
 
-    // Rebalance based on balance factor and new element's position
-    int balance = BalanceFactor(root);
-    if (balance > 1 && newElement->m_id < root->m_left->m_id) return rightRotate(root);
-    if (balance < -1 && newElement->m_id > root->m_right->m_id) return leftRotate(root);
-    if (balance > 1 && newElement->m_id > root->m_left->m_id) {
-        root->m_left = leftRotate(root->m_left);
-        return rightRotate(root);
+        // Rebalance based on balance factor and new element's position
+        int balance = BalanceFactor(root);
+        if (balance > 1) {
+            if (id > root->m_left->m_id) root->m_left = leftRotate(root->m_left);
+            *slot = rightRotate(root);
+            break; // A rotation restores the subtree's previous height
+        }
+        if (balance < -1) {
+            if (id < root->m_right->m_id) root->m_right = rightRotate(root->m_right);
+            *slot = leftRotate(root);
+            break;
+        }
+        if (root->m_height == before) break;
     }
-    if (balance < -1 && newElement->m_id < root->m_right->m_id) {
-        root->m_right = rightRotate(root->m_right);
-        return leftRotate(root);
+    return true;
+}
+
+// Inserts into a splay tree: a single splay for the ID either finds the
+// duplicate at the root or leaves its neighbour there to split around
+bool Fleet::insertSplay(const Ship& ship) {
+    m_root = splay(m_root, ship.m_id);
+    if (m_root && m_root->m_id == ship.m_id) return false;
+
+    Ship* node = m_pool.allocate(ship.m_id, ship.m_type, ship.m_state);
+    if (m_root) {
+        if (ship.m_id < m_root->m_id) {
+            node->m_left = m_root->m_left;
+            node->m_right = m_root;
+            m_root->m_left = nullptr;
+        } else {
+            node->m_right = m_root->m_right;
+            node->m_left = m_root;
+            m_root->m_right = nullptr;
+        }
+        updateHeight(m_root);
+        updateHeight(node);
     }
-    return root;
+    m_root = node;
+    return true;
 }
 
 // Performs a right rotation
 Ship* Fleet::rightRotate(Ship* node) {
     if (!node || !node->m_left) return node;
+    FLEET_COUNT(rotations, 1);
     Ship* A = node->m_left;
     Ship* B = A->m_right;
     A->m_right = node;
@@ -224,6 +1883,7 @@ Ship* Fleet::rightRotate(Ship* node) {
 // Performs a left rotation
 Ship* Fleet::leftRotate(Ship* node) {
     if (!node || !node->m_right) return node;
+    FLEET_COUNT(rotations, 1);
     Ship* A = node->m_right;
     Ship* B = A->m_left;
     A->m_left = node;
@@ -233,87 +1893,93 @@ Ship* Fleet::leftRotate(Ship* node) {
     return A;
 }
 
-// Removes a node from an AVL tree, rebalancing after deletion
-Ship* Fleet::removeAVL(Ship* root, int id) {
-    if (root == nullptr) return nullptr;
-
-    if (id < root->m_id) {
-        root->m_left = removeAVL(root->m_left, id);
-    } else if (id > root->m_id) {
-        root->m_right = removeAVL(root->m_right, id);
-    } else { // Node to be deleted
-        if (root->m_left == nullptr) {
-            Ship* temp = root->m_right;
-            delete root;
-            root = temp;
-        } else if (root->m_right == nullptr) {
-            Ship* temp = root->m_left;
-            delete root;
-            root = temp;
-        } else {
-            Ship* minRight = findMin(root->m_right);
-            root->m_id = minRight->m_id;
-            root->m_state = minRight->m_state;
-            root->m_right = removeAVL(root->m_right, minRight->m_id);
-        }
-    }
-    if (root) {
-        updateHeight(root); // Update height after removal
-        // Rebalance the tree if necessary
-        int balance = BalanceFactor(root);
-        if (balance > 1 && BalanceFactor(root->m_left) >= 0) root = rightRotate(root);
-        if (balance < -1 && BalanceFactor(root->m_right) <= 0) root = leftRotate(root);
-        if (balance > 1 && BalanceFactor(root->m_left) < 0) {
-            root->m_left = leftRotate(root->m_left);
-            root = rightRotate(root);
-        }
-        if (balance < -1 && BalanceFactor(root->m_right) > 0) {
-            root->m_right = rightRotate(root->m_right);
-            root = leftRotate(root);
-        }
+// Removes a node from an AVL tree, rebalancing along the retraced path
+bool Fleet::removeAVL(int id) {
+    if (!unlinkNode(id)) return false;
+    for (size_t i = m_path.size(); i-- > 0;) {
+        Ship** slot = m_path[i];
+        int before = (*slot)->m_height;
+        updateHeight(*slot);
+        *slot = rebalance(*slot);
+        // Unlike insertion, removal may rotate at several levels
+        if ((*slot)->m_height == before) break;
     }
-    return root;
+    return true;
 }
 
-// Splay function: brings the node with 'id' to the root
+// Top-down splay: brings the node with 'id' (or the last node on its
+// search path) to the root in a single descent. Nodes peeled off the path
+// are hung on the left/right spines of a header node and reassembled at the
+// end; their heights are then recomputed bottom-up from the m_spine record.
 Ship* Fleet::splay(Ship* root, int id) {
-    if (!root || root->m_id == id) return root;
-
-    if (id < root->m_id) { // Key is in left subtree
-        if (!root->m_left) return root;
-        if (id < root->m_left->m_id) { // Zig-Zig
-            root->m_left->m_left = splay(root->m_left->m_left, id);
-            root = rightRotate(root);
-        } else if (id > root->m_left->m_id) { // Zig-Zag
-            root->m_left->m_right = splay(root->m_left->m_right, id);
-            if (root->m_left->m_right) root->m_left = leftRotate(root->m_left);
-        }
-        return (root->m_left) ? rightRotate(root) : root;
-    } else { // Key is in right subtree
-        if (!root->m_right) return root;
-        if (id > root->m_right->m_id) { // Zag-Zag
-            root->m_right->m_right = splay(root->m_right->m_right, id);
-            root = leftRotate(root);
-        } else if (id < root->m_right->m_id) { // Zag-Zig
-            root->m_right->m_left = splay(root->m_right->m_left, id);
-            if (root->m_right->m_left) root->m_right = rightRotate(root->m_right);
+    if (!root) return root;
+    Ship header;
+    Ship* left = &header;   // largest node of the left tree
+    Ship* right = &header;  // smallest node of the right tree
+    Ship* t = root;
+    m_spine.clear();
+    while (true) {
+        FLEET_COUNT(comparisons, 1);
+        if (id < t->m_id) {
+            if (!t->m_left) break;
+            FLEET_COUNT(comparisons, 1);
+            if (id < t->m_left->m_id) { // Zig-Zig: rotate right first
+                Ship* child = t->m_left;
+                t->m_left = child->m_right;
+                child->m_right = t;
+                updateHeight(t);
+                FLEET_COUNT(rotations, 1);
+                t = child;
+                if (!t->m_left) break;
+            }
+            right->m_left = t; // Link into the right tree
+            right = t;
+            m_spine.push_back(t);
+            FLEET_COUNT(splaySteps, 1);
+            t = t->m_left;
+        } else if (id > t->m_id) {
+            if (!t->m_right) break;
+            FLEET_COUNT(comparisons, 1);
+            if (id > t->m_right->m_id) { // Zag-Zag: rotate left first
+                Ship* child = t->m_right;
+                t->m_right = child->m_left;
+                child->m_left = t;
+                updateHeight(t);
+                FLEET_COUNT(rotations, 1);
+                t = child;
+                if (!t->m_right) break;
+            }
+            left->m_right = t; // Link into the left tree
+            left = t;
+            m_spine.push_back(t);
+            FLEET_COUNT(splaySteps, 1);
+            t = t->m_right;
+        } else {
+            break;
         }
-        return (root->m_right) ? leftRotate(root) : root;
     }
-}
-
-// Converts existing tree nodes into an AVL-balanced structure
-Ship* Fleet::nodeTransfer(Ship* root) {
-    if (!root) return nullptr;
-    root->m_left = nodeTransfer(root->m_left);
-    root->m_right = nodeTransfer(root->m_right);
-    return rebalance(root); // Rebalance after children are processed
+    // Reassemble: t's subtrees finish the spines, the spines become t's children
+    left->m_right = t->m_left;
+    right->m_left = t->m_right;
+    t->m_left = header.m_right;
+    t->m_right = header.m_left;
+    // Later links sit deeper on their spine, so reverse order is bottom-up
+    for (size_t i = m_spine.size(); i-- > 0;)
+        updateHeight(m_spine[i]);
+    updateHeight(t);
+    return t;
 }
 
 // Helper to rebalance a single node in an AVL tree
 Ship* Fleet::rebalance(Ship* root) {
     if (!root) return nullptr;
     int balance = BalanceFactor(root);
+    if (m_shared && (balance > 1 || balance < -1)) {
+        // The taller child and its inner child may lie off the removal path
+        Ship** taller = (balance > 1) ? &root->m_left : &root->m_right;
+        unshare(taller);
+        unshare((balance > 1) ? &(*taller)->m_right : &(*taller)->m_left);
+    }
 
     // Apply rotations if unbalanced
     if (balance > 1 && BalanceFactor(root->m_left) >= 0) return rightRotate(root);
@@ -330,21 +1996,24 @@ Ship* Fleet::rebalance(Ship* root) {
 }
 
 // Removes a node from a Splay tree
-void Fleet::removeSplay(int id) {
-    if (!m_root) return;
+bool Fleet::removeSplay(int id) {
+    if (!m_root) return false;
 
     m_root = splay(m_root, id); // Splay the node to be removed to the root
 
-    if (m_root->m_id != id) return; // Key not found
+    if (m_root->m_id != id) return false; // Key not found
 
     if (!m_root->m_left) { // No left child
         Ship* temp = m_root;
         m_root = m_root->m_right;
-        delete temp;
+        m_pool.release(temp);
     } else { // Has a left child
         Ship* temp = m_root;
+        if (m_shared) ownPath(&m_root->m_left, id); // Its largest ship's path
         m_root = splay(m_root->m_left, id); // Splay max of left subtree to root
         m_root->m_right = temp->m_right; // Attach original right subtree
-        delete temp;
+        updateHeight(m_root);
+        m_pool.release(temp);
     }
+    return true;
 }
\ No newline at end of file
@@ -1,12 +1,28 @@
 #ifndef FLEET_H
 #define FLEET_H
 #include <iostream>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <iterator>
+#include <string_view>
 using namespace std;
 class Tester;
 class Fleet;
+class ShipPool;
+class FleetSnapshot;
+class FleetColumns;
+class FleetJournal;
+class FleetSink;
+class FleetVersion;
+struct FleetVersionState;
 enum STATE {ALIVE, LOST};   // possible states for a ship
 enum SHIPTYPE {CARGO, TELESCOPE, COMMUNICATOR, FUELCARRIER, ROBOCARRIER};
-enum TREETYPE {NONE, BST, AVL, SPLAY};
+enum TREETYPE {NONE, BST, AVL, SPLAY, DENSE, BTREE};
+enum UPDATEOP {ADDSHIP, REMOVESHIP, RETAGSHIP, SETSTATE, SETTYPE, UPSERTSHIP}; // batch event kinds
+enum EXPORTFORMAT {CSV, JSONL};     // formats of Fleet::exportShips
+const int SHIPTYPES = 5;    // number of SHIPTYPE values
 const int MINID = 10000;    // min ship ID
 const int MAXID = 99999;    // max ship ID
 #define DEFAULT_HEIGHT 0
@@ -17,50 +33,56 @@ const int MAXID = 99999;    // max ship ID
 class Ship{
     public:
     friend class Fleet;
+    friend class ShipPool;
     friend class Grader;
     friend class Tester;
     Ship(int id, SHIPTYPE type = DEFAULT_TYPE, STATE state = DEFAULT_STATE)
         :m_id(id),m_type(type), m_state(state) {
+            m_refs = 1;
             m_left = nullptr;
             m_right = nullptr;
             m_height = DEFAULT_HEIGHT;
+            m_size = 1;
+            initCounts();
         }
     Ship(){
         m_id = DEFAULT_ID;
         m_type = DEFAULT_TYPE;
         m_state = DEFAULT_STATE;
+        m_refs = 1;
         m_left = nullptr;
         m_right = nullptr;
         m_height = DEFAULT_HEIGHT;
+        m_size = 1;
+        initCounts();
     }
     int getID() const {return m_id;}
     STATE getState() const {return m_state;}
-    string getStateStr() const {
-        string text = "";
+    //names are static strings, nothing is built per call
+    std::string_view getStateStr() const {
         switch (m_state)
         {
-        case LOST:text = "LOST";break;
-        case ALIVE:text = "ALIVE";break;
-        default:text = "UNKNOWN";break;
+        case LOST:return "LOST";
+        case ALIVE:return "ALIVE";
+        default:return "UNKNOWN";
         }
-        return text;
     }
     SHIPTYPE getType() const {return m_type;}
-    string getTypeStr() const {
-        string text = "";
+    std::string_view getTypeStr() const {
         switch (m_type)
         {
-        case CARGO:text = "CARGO";break;
-        case TELESCOPE:text = "TELESCOPE";break;
-        case COMMUNICATOR:text = "COMMUNICATOR";break;
-        case FUELCARRIER:text = "FUELCARRIER";break;
-        case ROBOCARRIER:text = "ROBOCARRIER";break;
-        default:text = "UNKNOWN";break;
+        case CARGO:return "CARGO";
+        case TELESCOPE:return "TELESCOPE";
+        case COMMUNICATOR:return "COMMUNICATOR";
+        case FUELCARRIER:return "FUELCARRIER";
+        case ROBOCARRIER:return "ROBOCARRIER";
+        default:return "UNKNOWN";
         }
-        return text
-        ;
     }
     int getHeight() const {return m_height;}
+    int getSize() const {return m_size;}
+    int getTypeCount(SHIPTYPE type) const {return m_typeCount[type];}
+    int getLostCount() const {return m_lostCount;}
     Ship* getLeft() const {return m_left;}
     Ship* getRight() const {return m_right;}
     void setID(const int id){m_id=id;}
@@ -73,31 +95,360 @@ class Ship{
     int m_id;
     SHIPTYPE m_type;
     STATE m_state;
+    int m_refs;     //links and versions holding this node, shared above one
     Ship* m_left;  //the pointer to the left child in the BST
     Ship* m_right; //the pointer to the right child in the BST
     int m_height;   //the height of this node in the BST
+    int m_size;     //the number of ships in this node's subtree
+    int m_typeCount[SHIPTYPES]; //ships of each type in this node's subtree
+    int m_lostCount;            //LOST ships in this node's subtree
+    //counts for a subtree holding only this ship
+    void initCounts() {
+        for (int type = 0; type < SHIPTYPES; type++) m_typeCount[type] = 0;
+        m_typeCount[m_type] = 1;
+        m_lostCount = (m_state == LOST);
+    }
+    //takes over another node's subtree size and counts
+    void copyCounts(const Ship& from) {
+        m_size = from.m_size;
+        for (int type = 0; type < SHIPTYPES; type++) m_typeCount[type] = from.m_typeCount[type];
+        m_lostCount = from.m_lostCount;
+    }
+};
+// One event of a batch passed to Fleet::applyUpdates. ADDSHIP inserts the
+// ship unless its ID is present, REMOVESHIP only uses the ID, RETAGSHIP
+// gives a present ship the event's type and state, SETSTATE and SETTYPE
+// change only one of them, and UPSERTSHIP inserts or overwrites.
+struct FleetUpdate{
+    UPDATEOP op;
+    Ship ship;
+};
+// Ships per type and per state, over the whole fleet or an ID range
+struct FleetTotals{
+    size_t ships;
+    size_t byType[SHIPTYPES];   // indexed by SHIPTYPE
+    size_t byState[2];          // indexed by STATE
+};
+// Operation counters and tree shape. The counters are only maintained when
+// the library is built with -DFLEET_STATS, otherwise they stay zero; the
+// height and depth histogram are measured by Fleet::stats() in every build.
+// BTREE fleets report their node levels, every ship sitting in a leaf;
+// DENSE fleets have no shape and report -1 and no depths.
+struct FleetStats{
+    unsigned long comparisons;  // key comparisons made while descending
+    unsigned long lookups;      // find() and contains() calls
+    unsigned long lookupComparisons;    // the comparisons made by those calls
+    unsigned long rotations;    // single rotations, a double rotation counts two
+    unsigned long splaySteps;   // zig, zig-zig and zig-zag steps of splay()
+    unsigned long allocations;  // nodes taken from the fleet's pool
+    int height;                 // edges from the root to the deepest ship, -1 when empty or DENSE
+    vector<size_t> depths;      // depths[d]: ships at depth d, the root at 0
 };
+// Slab allocator for the Ship nodes of one Fleet. Ships are carved out of
+// fixed-size slabs and recycled through a free list threaded through m_left,
+// so inserts and removes never touch the global heap once the pool is warm.
+class ShipPool{
+    public:
+    ShipPool();
+    ~ShipPool();
+    Ship* allocate(int id, SHIPTYPE type, STATE state);
+    void release(Ship* ship);
+    void clear();   // frees every slab at once, all nodes become invalid
+    void swap(ShipPool& other);     // exchanges the slabs of two pools
+    //takes over another pool's slabs and nodes; the unused tail of its
+    //newest slab is not handed out again
+    void adopt(ShipPool& other);
+    size_t live() const {return m_live;}
+    size_t capacity() const {return m_slabs.size() * SLAB_SIZE;}
+    //nodes handed out since the last resetAllocations(), counted with
+    //-DFLEET_STATS only; the count stays with the pool on swap()
+    unsigned long allocations() const {return m_allocations;}
+    void resetAllocations() {m_allocations = 0;}
+    private:
+    ShipPool(const ShipPool&);
+    ShipPool& operator=(const ShipPool&);
+    static const size_t SLAB_SIZE = 1024;   // ships per slab
+    vector<Ship*> m_slabs;  // raw slab storage
+    Ship* m_free;           // head of the recycled node list
+    size_t m_next;          // next unused slot in the newest slab
+    size_t m_live;          // nodes currently handed out
+    unsigned long m_allocations;    // see allocations()
+};
+// Direct-indexed table over the whole ID universe, used by DENSE fleets.
+// Every possible ID owns one byte holding its packed type and state, and an
+// occupancy bitset makes insert/remove/lookup O(1) and ordered walks a
+// word-at-a-time bit scan. Storage is allocated on the first insert.
+class DenseTable{
+    public:
+    static const int SLOTS = MAXID - MINID + 1;
+    DenseTable();
+    size_t size() const {return m_count;}
+    bool contains(int id) const;
+    bool insert(int id, SHIPTYPE type, STATE state);   // false if present
+    bool remove(int id);                                // false if absent
+    bool get(int id, Ship& out) const;  // copies ID, type and state
+    int next(int id) const;     // smallest stored ID >= id, or -1
+    int prev(int id) const;     // largest stored ID <= id, or -1
+    size_t rank(int id) const;  // number of stored IDs < id
+    const FleetTotals& totals() const {return m_totals;}
+    FleetTotals totalsInRange(int lo, int hi) const;   // scans [lo, hi]
+    bool retag(int id, SHIPTYPE type, STATE state);     // false if absent
+    int select(size_t k) const; // k-th smallest stored ID (from 0), or -1
+    void clear();               // drops the table storage
+    private:
+    static unsigned char pack(SHIPTYPE type, STATE state) {return (unsigned char)(state << 3 | type);}
+    vector<unsigned char> m_slots;  // packed type/state per ID offset
+    vector<uint64_t> m_bits;        // occupancy, one bit per ID offset
+    size_t m_count;                 // stored ships
+    FleetTotals m_totals;           // kept up to date by every change
+};
+// B+-tree used by BTREE fleets. Nodes span a few cache lines and keep their
+// keys in one aligned array, padded with INT_MAX, so a node is searched by
+// counting the keys below the probe with SIMD compares (AVX2 or SSE2 where
+// the compiler targets them, a scalar loop otherwise) instead of a chain of
+// dependent branches. Inner nodes also keep the ship count of every child
+// for rank/select, and the leaves are linked both ways for ordered scans.
+// The interface mirrors DenseTable.
+class BTreeTable{
+    public:
+    static const int KEYS = 32;     // keys per node, four AVX2 compares
+    BTreeTable();
+    BTreeTable(const BTreeTable& rhs);
+    BTreeTable& operator=(const BTreeTable& rhs);
+    ~BTreeTable();
+    size_t size() const {return m_count;}
+    bool contains(int id) const;
+    bool insert(int id, SHIPTYPE type, STATE state);   // false if present
+    bool remove(int id);                                // false if absent
+    bool get(int id, Ship& out) const;  // copies ID, type and state
+    int next(int id) const;     // smallest stored ID >= id, or -1
+    int prev(int id) const;     // largest stored ID <= id, or -1
+    size_t rank(int id) const;  // number of stored IDs < id
+    const FleetTotals& totals() const {return m_totals;}
+    FleetTotals totalsInRange(int lo, int hi) const;   // scans the leaves of [lo, hi]
+    bool retag(int id, SHIPTYPE type, STATE state);     // false if absent
+    int select(size_t k) const; // k-th smallest stored ID (from 0), or -1
+    void clear();               // frees every node
+    //replaces the contents with n ships sorted by unique ID, payload packed
+    //as state << 3 | type, filling the nodes bottom-up
+    void build(const int* ids, const unsigned char* payload, size_t n);
+    int height() const {return m_levels;}  // node levels, 0 when empty
+    //calls fn(id, type, state) for every ship with lo <= ID <= hi in ID
+    //order, walking the leaf chain
+    template <class Fn>
+    void forEach(int lo, int hi, Fn fn) const;
+    private:
+    struct alignas(64) Node{
+        int32_t keys[KEYS];     // sorted, unused slots hold INT_MAX
+        int count;              // keys in a leaf, children in an inner node
+        bool leaf;
+    };
+    struct Leaf : Node{
+        unsigned char payload[KEYS];    // packed type and state
+        Leaf* prev;
+        Leaf* next;
+    };
+    // keys[i] is the smallest ID under children[i + 1]
+    struct Inner : Node{
+        Node* children[KEYS + 1];
+        uint32_t sizes[KEYS + 1];       // ships under each child
+    };
+    struct Step{
+        Inner* node;
+        int child;
+    };
+    static const int MAX_LEVELS = 16;
+    static const int MIN_KEYS = KEYS / 2;           // fill of a non-root leaf
+    static const int MIN_CHILDREN = (KEYS + 1) / 2; // fill of a non-root inner node
+    static unsigned char pack(SHIPTYPE type, STATE state) {return (unsigned char)(state << 3 | type);}
+    static int countBelow(const int32_t* keys, int id);
+    const Leaf* findLeaf(int id) const;
+    Leaf* descend(int id, Step* path, int& depth) const;
+    void count(unsigned char payload, int delta);
+    void fixLeaf(Leaf* leaf, Step* path, int depth);
+    void fixInner(Inner* node, Step* path, int depth);
+    static void freeNode(Node* node);
+    Node* m_root;
+    Leaf* m_first;                  // leaf chain ends
+    Leaf* m_last;
+    int m_levels;
+    size_t m_count;
+    FleetTotals m_totals;
+};
+template <class Fn>
+void BTreeTable::forEach(int lo, int hi, Fn fn) const {
+    const Leaf* leaf = findLeaf(lo);
+    if (!leaf) return;
+    int i = countBelow(leaf->keys, lo);
+    while (leaf) {
+        for (; i < leaf->count; i++) {
+            if (leaf->keys[i] > hi) return;
+            fn(int(leaf->keys[i]), static_cast<SHIPTYPE>(leaf->payload[i] & 7), static_cast<STATE>(leaf->payload[i] >> 3));
+        }
+        leaf = leaf->next;
+        i = 0;
+    }
+}
 class Fleet{
     public:
     friend class Grader;
     friend class Tester;
+    friend class FleetVersion;
+    // Bidirectional iterator over the ships in ID order. Tree iterators keep
+    // the path from the root to the current ship, so stepping is amortized
+    // O(1) without parent links; DENSE and BTREE iterators hold a copy of the
+    // current ship. Any insert, remove or type change invalidates all iterators.
+    class const_iterator{
+        public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Ship value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Ship* pointer;
+        typedef const Ship& reference;
+        const_iterator() : m_fleet(nullptr) {}
+        reference operator*() const {return m_path.empty() ? m_ship : *m_path.back();}
+        pointer operator->() const {return &**this;}
+        const_iterator& operator++();
+        const_iterator& operator--();   // end() steps back to the last ship
+        const_iterator operator++(int) {const_iterator old(*this); ++*this; return old;}
+        const_iterator operator--(int) {const_iterator old(*this); --*this; return old;}
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const {return !(*this == rhs);}
+        private:
+        friend class Fleet;
+        explicit const_iterator(const Fleet* fleet) : m_fleet(fleet) {}
+        void descend(const Ship* node, bool leftmost); // pushes node and its leftmost/rightmost chain
+        const Fleet* m_fleet;
+        vector<const Ship*> m_path; // root to current ship, empty at end()
+        Ship m_ship;    // DENSE/BTREE: the current ship, ID DEFAULT_ID at end()
+    };
     Fleet();
     Fleet(TREETYPE type);
+    Fleet(const Fleet & rhs);
     ~Fleet();
     const Fleet & operator=(const Fleet & rhs);
     void clear();
     TREETYPE getType() const;
     void setType(TREETYPE type);
+    size_t size() const;
     void insert(const Ship& ship);
     void remove(int id);
+    //in-place changes of a stored ship, one descent and no rebalancing;
+    //false if the ID is absent. Never splays.
+    bool updateState(int id, STATE state);
+    bool updateType(int id, SHIPTYPE type);
+    //inserts the ship, or overwrites the type and state of the stored one
+    void upsert(const Ship& ship);
+    //adds many ships at once and rebuilds a perfectly balanced tree in
+    //linear time; invalid IDs and IDs already present are skipped
+    void bulkLoad(const Ship* ships, size_t n);
+    //batched mutations: the batch is sorted once, invalid IDs are dropped
+    //and the events of each ID are folded into at most one change, which
+    //has the same result as applying them one by one in batch order. Small
+    //batches update the tree in ID order, large ones are merged with it in
+    //order and rebuilt balanced.
+    void insertMany(const Ship* ships, size_t n);
+    void removeMany(const int* ids, size_t n);
+    void applyUpdates(const FleetUpdate* updates, size_t n);
+    void applyUpdates(const vector<FleetUpdate>& updates);
+    //lookups: SPLAY fleets splay the probed ID to the root, others only read
+    const Ship* find(int id);
+    bool contains(int id);
+    //answers a burst of lookups in one sweep, out[i] is null if ids[i] is absent
+    //(DENSE and BTREE fleets hand out copies that stay valid until the next
+    //lookup)
+    void findMany(const int* ids, size_t n, const Ship** out) const;
+    //writes the tree shape as nested "(id:height)" groups in ID order,
+    //iteratively and in buffered chunks; the plain form writes to cout
     void dumpTree() const;
+    void dumpTree(FleetSink& sink) const;
+    void dumpTree(std::ostream& out) const;
+    //writes one line per ship in ID order: CSV with an "id,type,state"
+    //header, or JSON lines {"id":..,"type":"..","state":".."}
+    void exportShips(FleetSink& sink, EXPORTFORMAT format) const;
+    void exportShips(std::ostream& out, EXPORTFORMAT format) const;
+    //calls fn(const Ship&) for every ship with lo <= ID <= hi in ID order,
+    //skipping subtrees outside the range: O(log n + k) on a balanced tree
+    template <class Fn>
+    void forEachInRange(int lo, int hi, Fn fn) const;
+    //ordered iteration; iterating never splays, even on SPLAY fleets
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator lowerBound(int id) const;   // first ship with ID >= id
+    const_iterator upperBound(int id) const;   // first ship with ID > id
+    //order statistics from the subtree sizes, O(log n) on balanced trees
+    //and never splaying; DENSE fleets count occupancy bits instead and
+    //BTREE fleets add up the child counts of their inner nodes
+    size_t rank(int id) const;                 // number of ships with ID < id
+    const_iterator select(size_t k) const;     // k-th ship by ID (from 0), or end()
+    size_t countInRange(int lo, int hi) const; // ships with lo <= ID <= hi
+    //ships per type and state, kept in every subtree: O(1) for the whole
+    //fleet and O(log n) for an ID range on balanced trees
+    FleetTotals totals() const;
+    FleetTotals totalsInRange(int lo, int hi) const;
+    //immutable Eytzinger-ordered copy for lock-free reads, rebuilt only
+    //when the fleet changed since the last publish
+    std::shared_ptr<const FleetSnapshot> publish();
+    //ID, type and state columns in ID order for vectorized filters, rebuilt
+    //only when the fleet changed since the last call
+    std::shared_ptr<const FleetColumns> columns();
+    //O(1) read-only version of the current ships that later changes never
+    //touch: the nodes become shared, and the first change on a path after
+    //a snapshot copies that path's shared nodes instead of modifying them.
+    //Dropped versions are reclaimed by the next change. DENSE and BTREE
+    //fleets have no nodes to share, so their versions copy the ships into a
+    //tree.
+    std::shared_ptr<const FleetVersion> snapshot();
+    //writes the ships in the binary format of fleet_file.h
+    bool save(const char* path) const;
+    //replaces the ships with a saved fleet: the file is mapped, validated
+    //and linked into a balanced tree in linear time. A NONE fleet becomes
+    //AVL; on failure the fleet is left unchanged.
+    bool load(const char* path);
+    //set operations with another fleet's IDs. merge adds the other fleet's
+    //ships whose IDs are missing (ships present in both are kept as they
+    //are), intersect keeps only ships whose IDs the other fleet has, and
+    //difference drops those. Two AVL fleets are combined with split and
+    //join in O(m log(n/m + 1)), reusing this fleet's nodes and running
+    //independent subtrees on up to 'threads' threads (0: one per core);
+    //other layouts merge the two ID orders in O(n + m) and come out
+    //balanced.
+    void merge(const Fleet& other, int threads = 0);
+    void intersect(const Fleet& other, int threads = 0);
+    void difference(const Fleet& other, int threads = 0);
+    //sends every change of the ships to the journal (null detaches);
+    //FleetJournal::recover() attaches itself
+    void attachJournal(FleetJournal* journal) {m_journal = journal;}
+    FleetStats stats() const;
+    void resetStats();
     private:
+    //one layout's insert, remove and lookup, each false/null if nothing
+    //changed or matched; picked once per type change by useType()
+    struct Engine{
+        bool (Fleet::*insert)(const Ship& ship);
+        bool (Fleet::*remove)(int id);
+        const Ship* (Fleet::*find)(int id);
+    };
+    static const Engine ENGINES[];  // indexed by TREETYPE
     Ship* m_root;  // the root of the BST
     TREETYPE m_type;// the type of tree
-
-
-    //helper function to clean up the fleet recursively
-    Ship* cleanFleet(Ship* theRoot);
+    const Engine* m_engine;// ENGINES[m_type]
+    ShipPool m_pool;// owns every node of the tree
+    vector<Ship**> m_path;// scratch: links visited by the last descent
+    vector<Ship*> m_spine;// scratch: nodes relinked by the last splay
+    FleetStats m_stats;// operation counters, see FLEET_STATS
+    DenseTable m_dense;// storage of DENSE fleets
+    BTreeTable m_btree;// storage of BTREE fleets
+    Ship m_found;// DENSE/BTREE: copy handed out by find()
+    mutable vector<Ship> m_lookup;// DENSE/BTREE: copies handed out by findMany()
+    unsigned long m_version;// bumped by every change to the ships
+    std::shared_ptr<const FleetSnapshot> m_snapshot;// last published snapshot
+    unsigned long m_snapshotVersion;// m_version when it was published
+    std::shared_ptr<const FleetColumns> m_columns;// last columns handed out
+    unsigned long m_columnsVersion;// m_version when they were built
+    FleetJournal* m_journal;// write-ahead journal of the changes, if any
+    std::shared_ptr<FleetVersionState> m_versions;// shared with the versions handed out
+    bool m_shared;// versions may share nodes, set by versionsAlive()
 
     //function to find a node in a BST
     Ship* findShip(Ship* node, int id);
@@ -105,19 +456,87 @@ class Fleet{
     //funtion to find minimum in a tree 
     Ship* findMin(Ship* node);
 
-    //update height function
+    //recomputes a node's height, subtree size and type/state counts from
+    //its children
     void updateHeight(Ship* node);
+    //sums a node's children's counts and its own
+    static void pullCounts(Ship* node);
+    //adds delta copies of a type/state to a node's subtree counts
+    static void addCounts(Ship* node, SHIPTYPE type, STATE state, int delta);
+    //totals of the ships with ID < id
+    FleetTotals totalsBelow(int id) const;
+    //descends to a ship without restructuring; m_path ends with its link
+    Ship* locate(int id);
+    //gives the node at the end of m_path a new type and state, moving it
+    //between the counts of every subtree on the path
+    void retagPath(Ship* node, SHIPTYPE type, STATE state);
+    //applies a RETAGSHIP, SETSTATE or SETTYPE event in place; returns false
+    //if the ID is absent
+    bool retag(const FleetUpdate& update);
+    //inserts or overwrites in one descent; returns false if nothing changed
+    bool upsertOne(const Ship& ship);
+    //unlinks and frees a node, leaving its search path in m_path
+    bool unlinkNode(int id);
+
+    //releases the nodes of dropped versions and reports whether any
+    //version may still share nodes with the tree
+    bool versionsAlive();
+    //replaces a shared node below a link with a private copy
+    void unshare(Ship** link);
+    //unshares every node on the search path of id below a link, so the
+    //engines may restructure that path in place
+    void ownPath(Ship** link, int id);
+    //unshares the whole tree before it is relinked by a rebuild
+    void ownAll();
+    //drops one holder of a subtree, freeing the nodes nobody holds anymore
+    void dropRef(Ship* root);
+    //frees every node; with versions alive the pool goes to their state
+    void releaseNodes();
+
+    //appends an event to the attached journal
+    void journal(UPDATEOP op, const Ship& ship);
+    //journals every stored ship as one op (REMOVESHIP before a clear,
+    //ADDSHIP after the ships were replaced)
+    void journalAll(UPDATEOP op);
+
+    //sets the layout and the engine serving it
+    void useType(TREETYPE type) {
+        m_type = type;
+        m_engine = &ENGINES[type];
+    }
+    //one insert/remove with the current engine, false if nothing changed
+    bool insertOne(const Ship& ship) {return (this->*m_engine->insert)(ship);}
+    bool removeOne(int id) {return (this->*m_engine->remove)(id);}
+
+    //engine entries of the tree layouts: the search path is unshared from
+    //any version first, then the named algorithm runs
+    template <bool (Fleet::*Insert)(const Ship&)>
+    bool insertOwned(const Ship& ship);
+    template <bool (Fleet::*Remove)(int)>
+    bool removeOwned(int id);
+    const Ship* findTree(int id) {return findShip(m_root, id);}
+    const Ship* findSplay(int id);
+    //engine entries of the DENSE and BTREE tables
+    bool insertDense(const Ship& ship) {return m_dense.insert(ship.m_id, ship.m_type, ship.m_state);}
+    bool insertBTree(const Ship& ship) {return m_btree.insert(ship.m_id, ship.m_type, ship.m_state);}
+    bool removeDense(int id) {return m_dense.remove(id);}
+    bool removeBTree(int id) {return m_btree.remove(id);}
+    const Ship* findDense(int id) {return m_dense.get(id, m_found) ? &m_found : nullptr;}
+    const Ship* findBTree(int id) {return m_btree.get(id, m_found) ? &m_found : nullptr;}
+    //engine entries of an untyped fleet, which holds nothing
+    bool insertNone(const Ship&) {return false;}
+    bool removeNone(int) {return false;}
+
     //remove function for a BST tree
-    Ship* removeBST(Ship* root, int id);
+    bool removeBST(int id);
 
-    //insert function for a BST type
-    Ship* insertBST(Ship* root, Ship* node);
+    //single-pass insert functions, each returns false for a duplicate ID
+    bool insertBST(const Ship& ship);
+    bool insertAVL(const Ship& ship);
+    bool insertSplay(const Ship& ship);
 
     //function to copy tree nodes from one Fleet object to another
-    Ship* copyTree(Ship* root);
-
-    //insertion function for AVL Tree
-    Ship* insertAVL(Ship* root, Ship* newElement);
+    Ship* copyTree(const Ship* root, ShipPool& pool);
 
     //Function to determine node balance factor
     int BalanceFactor(Ship* root);
@@ -127,20 +546,114 @@ class Fleet{
     Ship* rightRotate(Ship* node);
 
     //remove function for AVL type
-    Ship* removeAVL(Ship* root, int id);
+    bool removeAVL(int id);
 
     //Splay function for Splay Tree
     Ship* splay(Ship* root, int id);
 
-    //Node transfer function
-    Ship* nodeTransfer(Ship* root);
+    //moves between the tree layouts and the DENSE/BTREE tables
+    void treeToTable(TREETYPE type);
+    void tableToTree();
+    //lookups shared by the DENSE and BTREE layouts
+    bool isTable() const {return m_type == DENSE || m_type == BTREE;}
+    int tableNext(int id) const {return m_type == DENSE ? m_dense.next(id) : m_btree.next(id);}
+    int tablePrev(int id) const {return m_type == DENSE ? m_dense.prev(id) : m_btree.prev(id);}
+    bool tableGet(int id, Ship& out) const {return m_type == DENSE ? m_dense.get(id, out) : m_btree.get(id, out);}
+
+    //collects the tree's nodes in ID order
+    void flatten(vector<Ship*>& nodes) const;
+
+    //links nodes sorted by ID into a perfectly balanced tree
+    Ship* buildBalanced(Ship** nodes, size_t n);
 
     //nodes rebalancing function
     Ship* rebalance(Ship* root);
 
   //remove function for a splay tree
-  void removeSplay(int id);
+  bool removeSplay(int id);
+
+    //folds one ID's events onto its current ship (present says whether it
+    //exists); returns whether the ship exists afterwards
+    static bool foldUpdates(const FleetUpdate* updates, const unsigned long long* keys, size_t n,
+                            bool present, SHIPTYPE& type, STATE& state);
+
+    //in-order walk reporting subtree open/close events around each ship
+    template <class Visitor>
+    void walk(Visitor& visitor) const;
 
-    void dump(Ship* aShip) const;//helper for recursive traversal
+    //set operation kinds, and the allocator and freed nodes of one task
+    enum SETOP {UNITE, INTERSECT, SUBTRACT};
+    struct SetScratch{
+        ShipPool* pool;         // where new nodes come from
+        vector<Ship*> dropped;  // nodes to release once all tasks are done
+        ShipPool local;         // node source of a forked task
+    };
+    //shared entry of merge, intersect and difference
+    void setOperation(const Fleet& other, SETOP op, int threads);
+    //join-based AVL set operation of a subtree with another fleet's
+    //subtree; the two recursive halves run on their own thread while
+    //'forks' allows it
+    Ship* setAVL(Ship* mine, const Ship* theirs, SETOP op, SetScratch& scratch, int forks);
+    //joins two AVL trees whose IDs lie below and above mid
+    Ship* joinAVL(Ship* left, Ship* mid, Ship* right);
+    //joins two AVL trees without a middle node
+    Ship* joinAVL(Ship* left, Ship* right);
+    //splits an AVL tree into the ships below and above id; returns the
+    //detached node holding id, if any
+    Ship* splitAVL(Ship* root, int id, Ship*& left, Ship*& right);
+    //detaches the smallest node of an AVL tree, returns the rest
+    Ship* splitFirst(Ship* root, Ship*& first);
+
+    //in-order walk of the ships of a subtree with lo <= ID <= hi
+    template <class Fn>
+    static void forEachInSubtree(const Ship* node, int lo, int hi, Fn& fn);
+
+    //positions an iterator on the first ship with ID >= id (or > id)
+    const_iterator seek(int id, bool inclusive) const;
 };
+
+template <class Fn>
+void Fleet::forEachInRange(int lo, int hi, Fn fn) const {
+    if (m_type == BTREE) {
+        Ship ship;
+        m_btree.forEach(lo, hi, [&ship, &fn](int id, SHIPTYPE type, STATE state) {
+            ship.m_id = id;
+            ship.m_type = type;
+            ship.m_state = state;
+            fn(static_cast<const Ship&>(ship));
+        });
+        return;
+    }
+    if (m_type == DENSE) {
+        Ship ship;
+        for (int id = m_dense.next(lo); id != -1 && id <= hi; id = m_dense.next(id + 1)) {
+            m_dense.get(id, ship);
+            fn(static_cast<const Ship&>(ship));
+        }
+        return;
+    }
+    forEachInSubtree(m_root, lo, hi, fn);
+}
+
+// In-order walk that never descends left of lo and stops past hi
+template <class Fn>
+void Fleet::forEachInSubtree(const Ship* node, int lo, int hi, Fn& fn) {
+    vector<const Ship*> stack;
+    while (node || !stack.empty()) {
+        while (node) {
+            if (node->m_id < lo) {
+                node = node->m_right;
+            } else {
+                stack.push_back(node);
+                node = node->m_left;
+            }
+        }
+        if (stack.empty()) return; // Every remaining ship is below lo
+        node = stack.back();
+        stack.pop_back();
+        if (node->m_id > hi) return;
+        fn(*node);
+        node = node->m_right;
+    }
+}
 #endif 
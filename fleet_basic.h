@@ -0,0 +1,372 @@
+#ifndef FLEET_BASIC_H
+#define FLEET_BASIC_H
+#include "fleet.h"
+
+// Standalone ordered set of ships with its tree engine fixed at compile
+// time. A policy supplies the node type and the insert/remove/find
+// algorithms, so BasicFleet<AVLPolicy> and friends compile to straight-line
+// code, and each engine's node carries only what it needs: 24 bytes, of
+// which only the AVL node uses one byte for its height. It shares no code
+// with Fleet and makes no promise about tree shape beyond each policy's own
+// invariants; there are no subtree counts, versions or journal, and no type
+// switching. Use Fleet for those.
+
+// Node of the BST and splay engines: ID, payload and two links
+struct PlainNode{
+    int id;
+    unsigned char type, state;
+    PlainNode* left;
+    PlainNode* right;
+    int getID() const {return id;}
+    SHIPTYPE getType() const {return static_cast<SHIPTYPE>(type);}
+    STATE getState() const {return static_cast<STATE>(state);}
+};
+
+// AVL node; the height fits in the padding after the payload
+struct AVLNode{
+    int id;
+    unsigned char type, state;
+    signed char height;         // leaf 0
+    AVLNode* left;
+    AVLNode* right;
+    int getID() const {return id;}
+    SHIPTYPE getType() const {return static_cast<SHIPTYPE>(type);}
+    STATE getState() const {return static_cast<STATE>(state);}
+};
+
+// Slab allocator for one node type, recycling through a free list threaded
+// through 'left', like ShipPool
+template <class Node>
+class BasicPool{
+    public:
+    BasicPool() : m_free(nullptr), m_next(SLAB_SIZE) {}
+    ~BasicPool() {clear();}
+    Node* allocate(const Ship& ship) {
+        Node* node;
+        if (m_free) {
+            node = m_free;
+            m_free = m_free->left;
+        } else {
+            if (m_next == SLAB_SIZE) {
+                m_slabs.push_back(static_cast<Node*>(::operator new(SLAB_SIZE * sizeof(Node))));
+                m_next = 0;
+            }
+            node = m_slabs.back() + m_next++;
+        }
+        node->id = ship.getID();
+        node->type = static_cast<unsigned char>(ship.getType());
+        node->state = static_cast<unsigned char>(ship.getState());
+        node->left = node->right = nullptr;
+        return node;
+    }
+    void release(Node* node) {
+        node->left = m_free;
+        m_free = node;
+    }
+    void clear() {
+        for (size_t i = 0; i < m_slabs.size(); i++) ::operator delete(m_slabs[i]);
+        m_slabs.clear();
+        m_free = nullptr;
+        m_next = SLAB_SIZE;
+    }
+    private:
+    BasicPool(const BasicPool&);
+    BasicPool& operator=(const BasicPool&);
+    static const size_t SLAB_SIZE = 1024;   // nodes per slab
+    vector<Node*> m_slabs;
+    Node* m_free;
+    size_t m_next;
+};
+
+// Unbalanced binary search tree. Removal of a node with two children moves
+// its in-order successor into its place.
+struct BSTPolicy{
+    typedef PlainNode Node;
+    typedef vector<Node**> Path;    // unused, no retracing
+
+    static Node* find(Node*& root, int id) {
+        Node* node = root;
+        while (node && node->id != id) node = (id < node->id) ? node->left : node->right;
+        return node;
+    }
+    static bool insert(Node*& root, const Ship& ship, BasicPool<Node>& pool, Path&) {
+        Node** link = &root;
+        while (*link) {
+            if (ship.getID() == (*link)->id) return false;
+            link = (ship.getID() < (*link)->id) ? &(*link)->left : &(*link)->right;
+        }
+        *link = pool.allocate(ship);
+        return true;
+    }
+    static Node* remove(Node*& root, int id, Path&) {
+        Node** link = &root;
+        while (*link && (*link)->id != id) link = (id < (*link)->id) ? &(*link)->left : &(*link)->right;
+        Node* node = *link;
+        if (!node) return nullptr;
+        if (!node->left || !node->right) {
+            *link = node->left ? node->left : node->right;
+            return node;
+        }
+        Node** next = &node->right;
+        while ((*next)->left) next = &(*next)->left;
+        Node* successor = *next;
+        *next = successor->right;
+        successor->left = node->left;
+        successor->right = node->right;
+        *link = successor;
+        return node;
+    }
+};
+
+// Height-balanced tree: one descent records the links, the retrace updates
+// heights and rotates
+struct AVLPolicy{
+    typedef AVLNode Node;
+    typedef vector<Node**> Path;    // links visited by the last descent
+
+    static int height(const Node* node) {return node ? node->height : -1;}
+    static void updateHeight(Node* node) {
+        int left = height(node->left), right = height(node->right);
+        node->height = static_cast<signed char>(1 + (left > right ? left : right));
+    }
+    static int balance(const Node* node) {return height(node->left) - height(node->right);}
+    static Node* rightRotate(Node* node) {
+        Node* child = node->left;
+        node->left = child->right;
+        child->right = node;
+        updateHeight(node);
+        updateHeight(child);
+        return child;
+    }
+    static Node* leftRotate(Node* node) {
+        Node* child = node->right;
+        node->right = child->left;
+        child->left = node;
+        updateHeight(node);
+        updateHeight(child);
+        return child;
+    }
+    static Node* rebalance(Node* node) {
+        int factor = balance(node);
+        if (factor > 1) {
+            if (balance(node->left) < 0) node->left = leftRotate(node->left);
+            return rightRotate(node);
+        }
+        if (factor < -1) {
+            if (balance(node->right) > 0) node->right = rightRotate(node->right);
+            return leftRotate(node);
+        }
+        return node;
+    }
+
+    static Node* find(Node*& root, int id) {
+        Node* node = root;
+        while (node && node->id != id) node = (id < node->id) ? node->left : node->right;
+        return node;
+    }
+    static bool insert(Node*& root, const Ship& ship, BasicPool<Node>& pool, Path& path) {
+        int id = ship.getID();
+        path.clear();
+        Node** link = &root;
+        while (*link) {
+            if (id == (*link)->id) return false;
+            path.push_back(link);
+            link = (id < (*link)->id) ? &(*link)->left : &(*link)->right;
+        }
+        *link = pool.allocate(ship);
+        (*link)->height = 0;
+        for (size_t i = path.size(); i-- > 0;) {
+            Node* node = *path[i];
+            int before = node->height;
+            updateHeight(node);
+            int factor = balance(node);
+            if (factor > 1 || factor < -1) {
+                *path[i] = rebalance(node);
+                break; // A rotation restores the subtree's previous height
+            }
+            if (node->height == before) break;
+        }
+        return true;
+    }
+    static Node* remove(Node*& root, int id, Path& path) {
+        path.clear();
+        Node** link = &root;
+        while (*link && (*link)->id != id) {
+            path.push_back(link);
+            link = (id < (*link)->id) ? &(*link)->left : &(*link)->right;
+        }
+        Node* node = *link;
+        if (!node) return nullptr;
+        if (!node->left || !node->right) {
+            *link = node->left ? node->left : node->right;
+        } else {
+            // The successor takes the node's place; its old parent chain
+            // below that place is retraced as well
+            size_t slot = path.size();
+            path.push_back(link);
+            Node** next = &node->right;
+            while ((*next)->left) {
+                path.push_back(next);
+                next = &(*next)->left;
+            }
+            Node* successor = *next;
+            *next = successor->right;
+            successor->left = node->left;
+            successor->right = node->right;
+            successor->height = node->height;
+            *link = successor;
+            // The first recorded link below the node hangs off the successor now
+            if (path.size() > slot + 1) path[slot + 1] = &successor->right;
+        }
+        for (size_t i = path.size(); i-- > 0;) {
+            Node* parent = *path[i];
+            int before = parent->height;
+            updateHeight(parent);
+            *path[i] = rebalance(parent);
+            // Unlike insertion, removal may rotate at several levels
+            if ((*path[i])->height == before) break;
+        }
+        return node;
+    }
+};
+
+// Top-down splay tree. Without heights or counts to maintain, a splay is a
+// single descent that relinks nodes and touches nothing else.
+struct SplayPolicy{
+    typedef PlainNode Node;
+    typedef vector<Node**> Path;    // unused, the splay needs no record
+
+    static Node* splay(Node* root, int id) {
+        if (!root) return root;
+        Node header;
+        header.left = header.right = nullptr;
+        Node* left = &header;   // largest node of the left tree
+        Node* right = &header;  // smallest node of the right tree
+        Node* t = root;
+        while (true) {
+            if (id < t->id) {
+                if (!t->left) break;
+                if (id < t->left->id) { // Zig-Zig: rotate right first
+                    Node* child = t->left;
+                    t->left = child->right;
+                    child->right = t;
+                    t = child;
+                    if (!t->left) break;
+                }
+                right->left = t;
+                right = t;
+                t = t->left;
+            } else if (id > t->id) {
+                if (!t->right) break;
+                if (id > t->right->id) { // Zag-Zag: rotate left first
+                    Node* child = t->right;
+                    t->right = child->left;
+                    child->left = t;
+                    t = child;
+                    if (!t->right) break;
+                }
+                left->right = t;
+                left = t;
+                t = t->right;
+            } else {
+                break;
+            }
+        }
+        left->right = t->left;
+        right->left = t->right;
+        t->left = header.right;
+        t->right = header.left;
+        return t;
+    }
+    static Node* find(Node*& root, int id) {
+        root = splay(root, id);
+        return (root && root->id == id) ? root : nullptr;
+    }
+    static bool insert(Node*& root, const Ship& ship, BasicPool<Node>& pool, Path&) {
+        root = splay(root, ship.getID());
+        if (root && root->id == ship.getID()) return false;
+        Node* node = pool.allocate(ship);
+        if (root) {
+            if (ship.getID() < root->id) {
+                node->left = root->left;
+                node->right = root;
+                root->left = nullptr;
+            } else {
+                node->right = root->right;
+                node->left = root;
+                root->right = nullptr;
+            }
+        }
+        root = node;
+        return true;
+    }
+    static Node* remove(Node*& root, int id, Path&) {
+        root = splay(root, id);
+        if (!root || root->id != id) return nullptr;
+        Node* node = root;
+        if (!node->left) {
+            root = node->right;
+        } else {
+            // The left subtree's largest node has no right child after the splay
+            root = splay(node->left, id);
+            root->right = node->right;
+        }
+        return node;
+    }
+};
+
+template <class Policy>
+class BasicFleet{
+    public:
+    typedef typename Policy::Node Node;
+    BasicFleet() : m_root(nullptr), m_size(0) {}
+    size_t size() const {return m_size;}
+    void clear() {
+        m_pool.clear();
+        m_root = nullptr;
+        m_size = 0;
+    }
+    //false if the ID is invalid or taken
+    bool insert(const Ship& ship) {
+        if (ship.getID() < MINID || ship.getID() > MAXID) return false;
+        if (!Policy::insert(m_root, ship, m_pool, m_path)) return false;
+        m_size++;
+        return true;
+    }
+    //false if the ID is absent
+    bool remove(int id) {
+        Node* node = Policy::remove(m_root, id, m_path);
+        if (!node) return false;
+        m_pool.release(node);
+        m_size--;
+        return true;
+    }
+    //the splay engine moves the ship to the root
+    const Node* find(int id) {return Policy::find(m_root, id);}
+    bool contains(int id) {return find(id) != nullptr;}
+    //calls fn(const Node&) for every ship in ID order
+    template <class Fn>
+    void forEach(Fn fn) const {
+        vector<const Node*> stack;
+        const Node* node = m_root;
+        while (node || !stack.empty()) {
+            while (node) {
+                stack.push_back(node);
+                node = node->left;
+            }
+            node = stack.back();
+            stack.pop_back();
+            fn(*node);
+            node = node->right;
+        }
+    }
+    const Node* root() const {return m_root;}
+    private:
+    BasicFleet(const BasicFleet&);
+    BasicFleet& operator=(const BasicFleet&);
+    Node* m_root;
+    size_t m_size;
+    BasicPool<Node> m_pool;
+    typename Policy::Path m_path;   // scratch for the engines that retrace
+};
+#endif
@@ -0,0 +1,1093 @@
+#include "fleet.h"
+#include "fleet_compact.h"
+#include "fleet_snapshot.h"
+#include "fleet_concurrent.h"
+#include "fleet_sharded.h"
+#include "fleet_file.h"
+#include "fleet_journal.h"
+#include "fleet_sink.h"
+#include "fleet_version.h"
+#include "fleet_basic.h"
+#include "fleet_columns.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Benchmarks for the Fleet engines. Every section uses fixed seeds so runs
+// are comparable; pass section names on the command line to run a subset.
+
+// Wall clock stopwatch in nanoseconds
+class Timer {
+public:
+    Timer() : m_start(std::chrono::steady_clock::now()) {}
+    double elapsedNs() const {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+    }
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Shuffled list of valid ship IDs, fixed seed
+static vector<int> shuffledIDs(int count, unsigned seed = 10) {
+    vector<int> ids;
+    for (int id = MINID; id <= MAXID; id++) ids.push_back(id);
+    std::mt19937 gen(seed);
+    shuffle(ids.begin(), ids.end(), gen);
+    ids.resize(min<size_t>(count, ids.size()));
+    return ids;
+}
+
+// Prints one result line
+static void report(const char* name, double totalNs, size_t ops) {
+    cout << "  " << name << ": " << totalNs / ops << " ns/op (" << ops << " ops)" << endl;
+}
+
+// Prevents the optimizer from discarding benchmark results
+static volatile long g_sink = 0;
+
+// Friend of Fleet, used to replay the old internal code paths
+class Tester {
+public:
+    // Duplicate check in a separate descent, as Fleet::insert used to do
+    static void twoPassInsert(Fleet& fleet, const Ship& ship) {
+        if (!fleet.findShip(fleet.m_root, ship.getID())) fleet.insert(ship);
+    }
+    // Sums IDs in order, from the table or with an in-order walk of the tree
+    static long orderedSum(const Fleet& fleet) {
+        long sum = 0;
+        if (fleet.m_type == DENSE) {
+            for (int id = fleet.m_dense.next(MINID); id != -1; id = fleet.m_dense.next(id + 1)) sum += id;
+            return sum;
+        }
+        if (fleet.m_type == BTREE) {
+            fleet.m_btree.forEach(MINID, MAXID, [&sum](int id, SHIPTYPE, STATE) { sum += id; });
+            return sum;
+        }
+        vector<const Ship*> stack;
+        const Ship* node = fleet.m_root;
+        while (node || !stack.empty()) {
+            while (node) {
+                stack.push_back(node);
+                node = node->getLeft();
+            }
+            node = stack.back();
+            stack.pop_back();
+            sum += node->getID();
+            node = node->getRight();
+        }
+        return sum;
+    }
+    // Bytes reserved by a fleet's node slabs
+    static size_t poolBytes(const Fleet& fleet) {
+        return fleet.m_pool.capacity() * sizeof(Ship);
+    }
+    // Plain descent without splaying
+    static const Ship* lookup(Fleet& fleet, int id) {
+        return fleet.findShip(fleet.m_root, id);
+    }
+    // Recursive dump with one << per token, as Fleet::dumpTree used to do
+    static void recursiveDump(const Ship* node, ostream& out) {
+        if (!node) return;
+        out << "(";
+        recursiveDump(node->getLeft(), out);
+        out << node->getID() << ":" << node->getHeight();
+        recursiveDump(node->getRight(), out);
+        out << ")";
+    }
+    static const Ship* root(const Fleet& fleet) {return fleet.m_root;}
+    // Nodes handed out by a fleet's pool, including those only versions hold
+    static size_t poolLive(const Fleet& fleet) {return fleet.m_pool.live();}
+};
+
+// Node allocation: ShipPool versus plain new/delete
+void benchPool() {
+    const int rounds = 20;
+    const int count = 50000;
+    cout << "\nNode allocation, " << count << " ships x " << rounds << " reloads:\n";
+    vector<Ship*> nodes(count);
+    {
+        Timer t;
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < count; i++) nodes[i] = new Ship(MINID + i);
+            for (int i = 0; i < count; i++) g_sink += nodes[i]->getID();
+            for (int i = 0; i < count; i++) delete nodes[i];
+        }
+        report("new/delete", t.elapsedNs(), size_t(rounds) * count);
+    }
+    {
+        ShipPool pool;
+        Timer t;
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < count; i++) nodes[i] = pool.allocate(MINID + i, CARGO, ALIVE);
+            for (int i = 0; i < count; i++) g_sink += nodes[i]->getID();
+            pool.clear();
+        }
+        report("ShipPool + clear()", t.elapsedNs(), size_t(rounds) * count);
+    }
+
+    // Churn: remove and re-add a random half of the fleet
+    vector<int> ids = shuffledIDs(count);
+    cout << "\nFleet reload and churn, " << count << " ships:\n";
+    {
+        Timer t;
+        for (int r = 0; r < rounds; r++) {
+            Fleet fleet(AVL);
+            for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+            for (size_t i = 0; i < ids.size(); i += 2) fleet.remove(ids[i]);
+            for (size_t i = 0; i < ids.size(); i += 2) fleet.insert(Ship(ids[i]));
+        }
+        report("AVL fleet build/churn/destroy", t.elapsedNs(), size_t(rounds) * count * 2);
+    }
+}
+
+// Comparisons per insert: separate duplicate check versus single descent
+void benchInsert() {
+    const TREETYPE types[] = {BST, AVL, SPLAY};
+    const char* names[] = {"BST", "AVL", "SPLAY"};
+    vector<int> ids = shuffledIDs(50000);
+    // Every third insert is a duplicate, as in a reload on top of old data
+    vector<int> feed;
+    for (size_t i = 0; i < ids.size(); i++) {
+        feed.push_back(ids[i]);
+        if (i % 3 == 2) feed.push_back(ids[i / 2]);
+    }
+    cout << "\nInsert, " << ids.size() << " ships + " << feed.size() - ids.size() << " duplicates:\n";
+#ifndef FLEET_STATS
+    cout << "  (build with -DFLEET_STATS to count comparisons)\n";
+#endif
+    for (int t = 0; t < 3; t++) {
+        for (int pass = 0; pass < 2; pass++) {
+            Fleet fleet(types[t]);
+            Timer timer;
+            for (size_t i = 0; i < feed.size(); i++) {
+                if (pass == 0) Tester::twoPassInsert(fleet, Ship(feed[i]));
+                else fleet.insert(Ship(feed[i]));
+            }
+            double ns = timer.elapsedNs();
+            cout << "  " << names[t] << (pass == 0 ? " two-pass:    " : " single-pass: ")
+                 << double(fleet.stats().comparisons) / feed.size() << " cmp/op, "
+                 << ns / feed.size() << " ns/op" << endl;
+        }
+    }
+}
+
+// Sorted, reverse-sorted and random feeds through every tree type
+void benchShapes() {
+    const int count = 20000;
+    const TREETYPE types[] = {BST, AVL, SPLAY};
+    const char* typeNames[] = {"BST", "AVL", "SPLAY"};
+    const char* feedNames[] = {"sorted", "reverse", "random"};
+    vector<int> feeds[3];
+    for (int i = 0; i < count; i++) feeds[0].push_back(MINID + i);
+    feeds[1].assign(feeds[0].rbegin(), feeds[0].rend());
+    feeds[2] = shuffledIDs(count);
+    vector<int> probes = shuffledIDs(count, 11);
+    cout << "\nTree shapes, " << count << " ships (insert / find / remove):\n";
+    for (int t = 0; t < 3; t++) {
+        for (int f = 0; f < 3; f++) {
+            Fleet fleet(types[t]);
+            const vector<int>& feed = feeds[f];
+            Timer insertTimer;
+            for (size_t i = 0; i < feed.size(); i++) fleet.insert(Ship(feed[i]));
+            double insertNs = insertTimer.elapsedNs();
+            Timer findTimer;
+            for (size_t i = 0; i < probes.size(); i++) g_sink += (Tester::lookup(fleet, probes[i]) != nullptr);
+            double findNs = findTimer.elapsedNs();
+            Timer removeTimer;
+            for (size_t i = 0; i < feed.size(); i++) fleet.remove(feed[i]);
+            double removeNs = removeTimer.elapsedNs();
+            cout << "  " << typeNames[t] << " " << feedNames[f] << ": "
+                 << insertNs / count << " / " << findNs / probes.size() << " / "
+                 << removeNs / count << " ns/op" << endl;
+        }
+    }
+}
+
+// Bursts of status queries: one find() per ID versus one findMany() per burst
+void benchLookup() {
+    const int count = 50000;
+    const size_t burst = 4000;
+    const TREETYPE types[] = {AVL, SPLAY};
+    const char* names[] = {"AVL", "SPLAY"};
+    vector<int> ids = shuffledIDs(count);
+    vector<int> probes = shuffledIDs(MAXID - MINID + 1, 12);
+    vector<const Ship*> out(burst);
+    cout << "\nLookup bursts of " << burst << " IDs, " << count << " ships:\n";
+    for (int t = 0; t < 2; t++) {
+        Fleet fleet(types[t]);
+        for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+        size_t bursts = probes.size() / burst;
+        Timer single;
+        for (size_t b = 0; b < bursts; b++)
+            for (size_t i = 0; i < burst; i++) out[i] = fleet.find(probes[b * burst + i]);
+        double singleNs = single.elapsedNs();
+        Timer batched;
+        for (size_t b = 0; b < bursts; b++) fleet.findMany(&probes[b * burst], burst, out.data());
+        double batchedNs = batched.elapsedNs();
+        cout << "  " << names[t] << " find(): " << singleNs / (bursts * burst) << " ns/id, findMany(): "
+             << batchedNs / (bursts * burst) << " ns/id" << endl;
+    }
+}
+
+// DENSE table against the AVL tree: updates, lookups and an ordered walk
+void benchDense() {
+    const int count = 80000;
+    vector<int> ids = shuffledIDs(count);
+    vector<int> probes = shuffledIDs(MAXID - MINID + 1, 13);
+    cout << "\nDENSE vs AVL, " << count << " ships (insert / find / ordered walk / remove):\n";
+    const TREETYPE types[] = {AVL, DENSE};
+    const char* names[] = {"AVL", "DENSE"};
+    for (int t = 0; t < 2; t++) {
+        Fleet fleet(types[t]);
+        Timer insertTimer;
+        for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+        double insertNs = insertTimer.elapsedNs();
+        Timer findTimer;
+        for (size_t i = 0; i < probes.size(); i++) g_sink += fleet.contains(probes[i]);
+        double findNs = findTimer.elapsedNs();
+        Timer walkTimer;
+        g_sink += Tester::orderedSum(fleet);
+        double walkNs = walkTimer.elapsedNs();
+        Timer removeTimer;
+        for (size_t i = 0; i < ids.size(); i++) fleet.remove(ids[i]);
+        double removeNs = removeTimer.elapsedNs();
+        cout << "  " << names[t] << ": " << insertNs / count << " / " << findNs / probes.size() << " / "
+             << walkNs / count << " / " << removeNs / count << " ns/op" << endl;
+    }
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    Timer toDense;
+    fleet.setType(DENSE);
+    double toDenseNs = toDense.elapsedNs();
+    Timer toTree;
+    fleet.setType(AVL);
+    cout << "  setType AVL->DENSE: " << toDenseNs / 1e6 << " ms, DENSE->AVL: " << toTree.elapsedNs() / 1e6 << " ms" << endl;
+}
+
+// Loading a fleet: one insert per ship versus bulkLoad, and BST -> AVL
+void benchBulk() {
+    const int count = 50000;
+    vector<int> ids = shuffledIDs(count);
+    vector<Ship> ships;
+    for (size_t i = 0; i < ids.size(); i++) ships.push_back(Ship(ids[i], static_cast<SHIPTYPE>(i % 5)));
+    cout << "\nLoading " << count << " ships:\n";
+    {
+        Fleet fleet(AVL);
+        Timer t;
+        for (size_t i = 0; i < ships.size(); i++) fleet.insert(ships[i]);
+        report("AVL insert() loop", t.elapsedNs(), count);
+    }
+    {
+        Fleet fleet(AVL);
+        Timer t;
+        fleet.bulkLoad(ships.data(), ships.size());
+        report("AVL bulkLoad()", t.elapsedNs(), count);
+    }
+    {
+        Fleet fleet(BST);
+        for (int id = MINID; id < MINID + 5000; id++) fleet.insert(Ship(id));
+        Timer t;
+        fleet.setType(AVL);
+        report("setType(AVL) on a 5000-deep BST", t.elapsedNs(), 5000);
+    }
+}
+
+// Footprint and lookup latency: Ship nodes versus the compact index store
+void benchCompact() {
+    const int count = 90000;
+    vector<int> ids = shuffledIDs(count);
+    vector<int> probes = shuffledIDs(count, 14);
+    cout << "\nNode layout, " << count << " ships:\n";
+    Fleet fleet(AVL);
+    CompactFleet compact;
+    for (size_t i = 0; i < ids.size(); i++) {
+        fleet.insert(Ship(ids[i]));
+        compact.insert(Ship(ids[i]));
+    }
+    cout << "  Ship nodes: " << sizeof(Ship) << " bytes/node, "
+         << Tester::poolBytes(fleet) / 1024 << " KiB reserved" << endl;
+    cout << "  CompactFleet: " << double(compact.memoryBytes()) / count << " bytes/node, "
+         << compact.memoryBytes() / 1024 << " KiB reserved" << endl;
+    for (int round = 0; round < 2; round++) {
+        Timer shipTimer;
+        for (size_t i = 0; i < probes.size(); i++) g_sink += fleet.contains(probes[i]);
+        double shipNs = shipTimer.elapsedNs();
+        Timer compactTimer;
+        for (size_t i = 0; i < probes.size(); i++) g_sink += compact.contains(probes[i]);
+        double compactNs = compactTimer.elapsedNs();
+        if (round == 1)
+            cout << "  lookup: Ship " << shipNs / probes.size() << " ns, compact "
+                 << compactNs / probes.size() << " ns" << endl;
+    }
+}
+
+// Read path: Eytzinger snapshot versus a findShip descent of an AVL fleet
+void benchSnapshot() {
+    const int count = 90000;
+    vector<int> ids = shuffledIDs(count);
+    vector<int> probes = shuffledIDs(MAXID - MINID + 1, 15);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    cout << "\nSnapshot reads, " << count << " ships:\n";
+    Timer publishTimer;
+    std::shared_ptr<const FleetSnapshot> snapshot = fleet.publish();
+    double publishNs = publishTimer.elapsedNs();
+    Timer republishTimer;
+    g_sink += (fleet.publish() == snapshot);
+    double republishNs = republishTimer.elapsedNs();
+    cout << "  publish: " << publishNs / 1e6 << " ms, unchanged republish: " << republishNs << " ns" << endl;
+    for (int round = 0; round < 2; round++) {
+        Timer treeTimer;
+        for (size_t i = 0; i < probes.size(); i++) g_sink += (Tester::lookup(fleet, probes[i]) != nullptr);
+        double treeNs = treeTimer.elapsedNs();
+        Timer snapTimer;
+        for (size_t i = 0; i < probes.size(); i++) g_sink += snapshot->contains(probes[i]);
+        double snapNs = snapTimer.elapsedNs();
+        if (round == 1)
+            cout << "  AVL findShip: " << treeNs / probes.size() << " ns, snapshot: "
+                 << snapNs / probes.size() << " ns" << endl;
+    }
+}
+
+// Runs 'threads' workers over a shared fleet and returns million ops/s.
+// Each worker issues reads with probability readPercent, otherwise it
+// alternates inserts and removes of random IDs.
+template <class Read, class Write>
+static double runThreads(int threads, int readPercent, int opsPerThread, Read read, Write write) {
+    vector<std::thread> workers;
+    Timer timer;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([=]() {
+            std::mt19937 gen(100 + t);
+            long hits = 0;
+            for (int i = 0; i < opsPerThread; i++) {
+                int id = MINID + gen() % (MAXID - MINID + 1);
+                if (int(gen() % 100) < readPercent) hits += read(id);
+                else write(id, (i & 1) != 0);
+            }
+            g_sink += hits;
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    return double(threads) * opsPerThread / timer.elapsedNs() * 1e3;
+}
+
+// Throughput at 1-32 threads: Fleet behind one global mutex versus
+// ConcurrentFleet with lock-free readers
+void benchConcurrent() {
+    const int count = 50000;
+    const int totalOps = 400000;
+    vector<int> ids = shuffledIDs(count);
+    const int readPercents[] = {100, 95, 50};
+    const int threadCounts[] = {1, 2, 4, 8, 16, 32};
+    cout << "\nConcurrent throughput, " << count << " ships, Mops/s (global mutex / ConcurrentFleet):\n";
+    for (int r = 0; r < 3; r++) {
+        cout << "  " << readPercents[r] << "% reads:";
+        for (int c = 0; c < 6; c++) {
+            int threads = threadCounts[c];
+            Fleet locked(AVL);
+            ConcurrentFleet concurrent;
+            for (size_t i = 0; i < ids.size(); i++) {
+                locked.insert(Ship(ids[i]));
+                concurrent.insert(Ship(ids[i]));
+            }
+            std::mutex lock;
+            double lockedOps = runThreads(threads, readPercents[r], totalOps / threads,
+                [&](int id) { std::lock_guard<std::mutex> guard(lock); return locked.contains(id); },
+                [&](int id, bool add) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (add) locked.insert(Ship(id));
+                    else locked.remove(id);
+                });
+            double concurrentOps = runThreads(threads, readPercents[r], totalOps / threads,
+                [&](int id) { return concurrent.contains(id); },
+                [&](int id, bool add) {
+                    if (add) concurrent.insert(Ship(id));
+                    else concurrent.remove(id);
+                });
+            cout << "  " << threads << "t " << lockedOps << "/" << concurrentOps;
+        }
+        cout << endl;
+    }
+}
+
+// Batched insert/remove of the same IDs into one Fleet and into sharded
+// fleets with 2-16 shards, then mixed single operations from 1-16 threads
+// against a global mutex and against per-shard locks
+void benchSharded() {
+    const int count = 80000;
+    vector<int> ids = shuffledIDs(count);
+    vector<Ship> ships;
+    for (size_t i = 0; i < ids.size(); i++) ships.push_back(Ship(ids[i]));
+    cout << "\nSharded batches, " << count << " ships:\n";
+    {
+        Fleet fleet(AVL);
+        Timer insert;
+        for (size_t i = 0; i < ships.size(); i++) fleet.insert(ships[i]);
+        double insertNs = insert.elapsedNs();
+        Timer remove;
+        for (size_t i = 0; i < ids.size(); i++) fleet.remove(ids[i]);
+        double removeNs = remove.elapsedNs();
+        cout << "  1 fleet: insert " << insertNs / count << " ns/op, remove " << removeNs / count << " ns/op" << endl;
+    }
+    const int shardCounts[] = {2, 4, 8, 16};
+    for (int c = 0; c < 4; c++) {
+        ShardedFleet sharded(shardCounts[c], AVL);
+        Timer insert;
+        sharded.insertMany(&ships[0], ships.size());
+        double insertNs = insert.elapsedNs();
+        Timer remove;
+        sharded.removeMany(&ids[0], ids.size());
+        double removeNs = remove.elapsedNs();
+        cout << "  " << shardCounts[c] << " shards: insert " << insertNs / count << " ns/op, remove "
+             << removeNs / count << " ns/op" << endl;
+    }
+
+    const int totalOps = 400000;
+    const int threadCounts[] = {1, 2, 4, 8, 16};
+    // Both fleets start from the same every-other ship
+    vector<Ship> half;
+    for (size_t i = 0; i < ships.size(); i += 2) half.push_back(ships[i]);
+    cout << "  95% reads, Mops/s (global mutex / 16 shards):";
+    for (int c = 0; c < 5; c++) {
+        int threads = threadCounts[c];
+        Fleet locked(AVL);
+        ShardedFleet sharded(16, AVL);
+        for (size_t i = 0; i < half.size(); i++) locked.insert(half[i]);
+        sharded.insertMany(&half[0], half.size());
+        std::mutex lock;
+        double lockedOps = runThreads(threads, 95, totalOps / threads,
+            [&](int id) { std::lock_guard<std::mutex> guard(lock); return locked.contains(id); },
+            [&](int id, bool add) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (add) locked.insert(Ship(id));
+                else locked.remove(id);
+            });
+        double shardedOps = runThreads(threads, 95, totalOps / threads,
+            [&](int id) { return sharded.contains(id); },
+            [&](int id, bool add) {
+                if (add) sharded.insert(Ship(id));
+                else sharded.remove(id);
+            });
+        cout << "  " << threads << "t " << lockedOps << "/" << shardedOps;
+    }
+    cout << endl;
+}
+
+// Sector-sized range queries on a balanced fleet: filtering a full in-order
+// walk versus the pruned forEachInRange and a lowerBound iterator scan
+void benchRange() {
+    const int count = 80000;
+    const int queries = 2000;
+    vector<int> ids = shuffledIDs(count);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    const int widths[] = {10, 100, 1000};
+    cout << "\nRange scans, " << count << " ships, ns per query (full walk / forEachInRange / iterator):\n";
+    for (int w = 0; w < 3; w++) {
+        std::mt19937 gen(20);
+        vector<int> starts;
+        for (int q = 0; q < queries; q++) starts.push_back(MINID + gen() % (MAXID - MINID + 1 - widths[w]));
+        long sum = 0;
+        Timer full;
+        for (int q = 0; q < queries; q += 20) {
+            int lo = starts[q], hi = lo + widths[w];
+            for (Fleet::const_iterator it = fleet.begin(); it != fleet.end(); ++it)
+                if (it->getID() >= lo && it->getID() <= hi) sum += it->getID();
+        }
+        double fullNs = full.elapsedNs() * 20;
+        Timer pruned;
+        for (int q = 0; q < queries; q++)
+            fleet.forEachInRange(starts[q], starts[q] + widths[w], [&sum](const Ship& ship) { sum += ship.getID(); });
+        double prunedNs = pruned.elapsedNs();
+        Timer iter;
+        for (int q = 0; q < queries; q++) {
+            int hi = starts[q] + widths[w];
+            for (Fleet::const_iterator it = fleet.lowerBound(starts[q]); it != fleet.end() && it->getID() <= hi; ++it)
+                sum += it->getID();
+        }
+        double iterNs = iter.elapsedNs();
+        g_sink += sum;
+        cout << "  width " << widths[w] << ": " << fullNs / queries << " / " << prunedNs / queries << " / "
+             << iterNs / queries << endl;
+    }
+}
+
+// Dashboard queries on a balanced fleet: counting a range by visiting it
+// versus countInRange, and paging to the k-th ship by stepping an iterator
+// versus select
+void benchOrder() {
+    const int count = 80000;
+    const int queries = 2000;
+    vector<int> ids = shuffledIDs(count);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    std::mt19937 gen(30);
+    vector<int> starts;
+    vector<size_t> ranks;
+    for (int q = 0; q < queries; q++) {
+        starts.push_back(MINID + gen() % (MAXID - MINID + 1 - 5000));
+        ranks.push_back(gen() % count);
+    }
+    long sum = 0;
+    Timer visit;
+    for (int q = 0; q < queries; q++)
+        fleet.forEachInRange(starts[q], starts[q] + 5000, [&sum](const Ship&) { sum++; });
+    double visitNs = visit.elapsedNs();
+    Timer counted;
+    for (int q = 0; q < queries; q++) sum += fleet.countInRange(starts[q], starts[q] + 5000);
+    double countNs = counted.elapsedNs();
+    Timer stepped;
+    for (int q = 0; q < queries; q += 20) {
+        Fleet::const_iterator it = fleet.begin();
+        for (size_t k = 0; k < ranks[q]; k++) ++it;
+        sum += it->getID();
+    }
+    double stepNs = stepped.elapsedNs() * 20;
+    Timer selected;
+    for (int q = 0; q < queries; q++) sum += fleet.select(ranks[q])->getID();
+    double selectNs = selected.elapsedNs();
+    g_sink += sum;
+    cout << "\nOrder statistics, " << count << " ships, ns per query:\n";
+    cout << "  count 5000-ID range: visit " << visitNs / queries << ", countInRange " << countNs / queries << endl;
+    cout << "  k-th ship: iterate " << stepNs / queries << ", select " << selectNs / queries << endl;
+}
+
+// Type/state report latency: counting with a full traversal (the old way)
+// versus the totals kept in the tree, for the whole fleet and for sectors
+void benchTotals() {
+    const int count = 80000;
+    const int queries = 2000;
+    vector<int> ids = shuffledIDs(count);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++)
+        fleet.insert(Ship(ids[i], static_cast<SHIPTYPE>(ids[i] % SHIPTYPES), (ids[i] % 7) ? ALIVE : LOST));
+    long sum = 0;
+    auto countAll = [&sum](const Ship& ship) { sum += ship.getType() + ship.getState(); };
+    Timer walked;
+    for (int q = 0; q < 20; q++) fleet.forEachInRange(MINID, MAXID, countAll);
+    double walkedNs = walked.elapsedNs() / 20;
+    Timer kept;
+    for (int q = 0; q < queries; q++) sum += fleet.totals().byState[LOST];
+    double keptNs = kept.elapsedNs() / queries;
+    std::mt19937 gen(40);
+    vector<int> starts;
+    for (int q = 0; q < queries; q++) starts.push_back(MINID + gen() % (MAXID - MINID + 1 - 10000));
+    Timer rangeWalked;
+    for (int q = 0; q < queries; q++) fleet.forEachInRange(starts[q], starts[q] + 10000, countAll);
+    double rangeWalkedNs = rangeWalked.elapsedNs() / queries;
+    Timer rangeKept;
+    for (int q = 0; q < queries; q++) sum += fleet.totalsInRange(starts[q], starts[q] + 10000).byType[CARGO];
+    double rangeKeptNs = rangeKept.elapsedNs() / queries;
+    g_sink += sum;
+    cout << "\nType/state reports, " << count << " ships, ns per report (traversal / kept totals):\n";
+    cout << "  whole fleet: " << walkedNs << " / " << keptNs << endl;
+    cout << "  10000-ID sector: " << rangeWalkedNs << " / " << rangeKeptNs << endl;
+}
+
+// Ingest throughput: batches of 10 to 100k add/remove events against a
+// 50000-ship fleet, applied one call per event versus with applyUpdates.
+// Each row feeds the same 200000 events to both fleets.
+void benchBatch() {
+    const int count = 50000;
+    const size_t events = 200000;
+    vector<int> ids = shuffledIDs(count);
+    std::mt19937 gen(50);
+    vector<FleetUpdate> stream(events);
+    for (size_t i = 0; i < events; i++) {
+        stream[i].op = (gen() % 2) ? ADDSHIP : REMOVESHIP;
+        stream[i].ship = Ship(MINID + gen() % (MAXID - MINID + 1));
+    }
+    const size_t batchSizes[] = {10, 100, 1000, 10000, 100000};
+    const TREETYPE types[] = {AVL, SPLAY};
+    const char* names[] = {"AVL", "SPLAY"};
+    cout << "\nBatched updates on " << count << " ships, ns per event (one by one / applyUpdates):\n";
+    for (int t = 0; t < 2; t++) {
+        cout << "  " << names[t] << ":";
+        for (int b = 0; b < 5; b++) {
+            Fleet single(types[t]), batched(types[t]);
+            for (size_t i = 0; i < ids.size(); i++) {
+                single.insert(Ship(ids[i]));
+                batched.insert(Ship(ids[i]));
+            }
+            Timer one;
+            for (size_t i = 0; i < events; i++) {
+                if (stream[i].op == ADDSHIP) single.insert(stream[i].ship);
+                else single.remove(stream[i].ship.getID());
+            }
+            double singleNs = one.elapsedNs();
+            Timer all;
+            for (size_t i = 0; i < events; i += batchSizes[b])
+                batched.applyUpdates(&stream[i], std::min(batchSizes[b], events - i));
+            double batchNs = all.elapsedNs();
+            if (single.size() != batched.size()) cout << " (mismatch)";
+            cout << "  " << batchSizes[b] << ": " << singleNs / events << "/" << batchNs / events;
+        }
+        cout << endl;
+    }
+}
+
+// The most frequent ingest event, a ship turning LOST: remove plus insert
+// of the changed ship versus updateState, one by one and as a batch
+void benchUpdate() {
+    const int count = 50000;
+    vector<int> ids = shuffledIDs(count);
+    std::mt19937 gen(60);
+    vector<int> targets;
+    for (int i = 0; i < 200000; i++) targets.push_back(ids[gen() % count]);
+    const TREETYPE types[] = {AVL, SPLAY, DENSE};
+    const char* names[] = {"AVL", "SPLAY", "DENSE"};
+    cout << "\nState updates on " << count << " ships, ns/op (remove+insert / updateState / batch of 1000):\n";
+    for (int t = 0; t < 3; t++) {
+        Fleet a(types[t]), b(types[t]), c(types[t]);
+        for (size_t i = 0; i < ids.size(); i++) {
+            a.insert(Ship(ids[i]));
+            b.insert(Ship(ids[i]));
+            c.insert(Ship(ids[i]));
+        }
+        Timer swap;
+        for (size_t i = 0; i < targets.size(); i++) {
+            a.remove(targets[i]);
+            a.insert(Ship(targets[i], DEFAULT_TYPE, (i % 2) ? ALIVE : LOST));
+        }
+        double swapNs = swap.elapsedNs();
+        Timer inPlace;
+        for (size_t i = 0; i < targets.size(); i++) b.updateState(targets[i], (i % 2) ? ALIVE : LOST);
+        double inPlaceNs = inPlace.elapsedNs();
+        vector<FleetUpdate> batch(1000);
+        Timer batched;
+        for (size_t i = 0; i < targets.size(); i += batch.size()) {
+            for (size_t j = 0; j < batch.size(); j++) {
+                batch[j].op = SETSTATE;
+                batch[j].ship = Ship(targets[i + j], DEFAULT_TYPE, ((i + j) % 2) ? ALIVE : LOST);
+            }
+            c.applyUpdates(batch);
+        }
+        double batchedNs = batched.elapsedNs();
+        cout << "  " << names[t] << ": " << swapNs / targets.size() << " / " << inPlaceNs / targets.size()
+             << " / " << batchedNs / targets.size() << endl;
+    }
+}
+
+// Restart cost: re-inserting every ship versus loading a saved file into a
+// balanced tree versus opening it read-only, plus lookups on the mapping
+void benchRestart() {
+    const int count = 90000;
+    const char* path = "fleet_bench.fleet";
+    vector<int> ids = shuffledIDs(count);
+    Fleet source(AVL);
+    for (size_t i = 0; i < ids.size(); i++) source.insert(Ship(ids[i], static_cast<SHIPTYPE>(i % 5)));
+    Timer saving;
+    source.save(path);
+    double saveNs = saving.elapsedNs();
+    Timer inserting;
+    Fleet inserted(AVL);
+    for (size_t i = 0; i < ids.size(); i++) inserted.insert(Ship(ids[i], static_cast<SHIPTYPE>(i % 5)));
+    double insertNs = inserting.elapsedNs();
+    Timer loading;
+    Fleet loaded(AVL);
+    loaded.load(path);
+    double loadNs = loading.elapsedNs();
+    Timer opening;
+    MappedFleet mapped;
+    mapped.open(path);
+    double openNs = opening.elapsedNs();
+    long hits = 0;
+    Timer treeFind;
+    for (size_t i = 0; i < ids.size(); i++) hits += loaded.contains(ids[i]);
+    double treeNs = treeFind.elapsedNs();
+    Timer mappedFind;
+    for (size_t i = 0; i < ids.size(); i++) hits += mapped.contains(ids[i]);
+    double mappedNs = mappedFind.elapsedNs();
+    g_sink += hits;
+    std::remove(path);
+    cout << "\nRestart with " << count << " ships:\n";
+    cout << "  save " << saveNs / 1e6 << " ms, re-insert " << insertNs / 1e6 << " ms, load " << loadNs / 1e6
+         << " ms, open mapped " << openNs / 1e6 << " ms" << endl;
+    cout << "  lookups: loaded tree " << treeNs / count << " ns, mapped file " << mappedNs / count << " ns" << endl;
+}
+
+// Mutation throughput of an AVL fleet without a journal and with journals
+// of growing group sizes: every group costs one write and one fdatasync,
+// plus recovery time for the resulting journal
+void benchJournal() {
+    const int count = 20000;
+    const char* snapshotPath = "fleet_bench.snapshot";
+    const char* journalPath = "fleet_bench.journal";
+    vector<int> ids = shuffledIDs(count);
+    std::mt19937 gen(70);
+    vector<int> targets;
+    for (int i = 0; i < count; i++) targets.push_back(ids[gen() % count]);
+    cout << "\nJournaled mutations (" << count << " inserts, " << count << " state updates), ns/op:\n";
+    const size_t groups[] = {0, 1, 16, 256, 4096};
+    for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+        std::remove(snapshotPath);
+        std::remove(journalPath);
+        Fleet fleet(AVL);
+        FleetJournal journal(groups[g] ? groups[g] : 1);
+        // Fewer events with a group size of one, each one waits for the disk
+        size_t events = (groups[g] == 1) ? count / 20 : count;
+        if (groups[g]) journal.recover(fleet, snapshotPath, journalPath);
+        Timer timer;
+        for (size_t i = 0; i < events; i++) fleet.insert(Ship(ids[i]));
+        for (size_t i = 0; i < events; i++) fleet.updateState(targets[i], (i % 2) ? ALIVE : LOST);
+        journal.commit();
+        double ns = timer.elapsedNs();
+        if (groups[g]) cout << "  group " << groups[g] << ": " << ns / (2 * events);
+        else cout << "  no journal: " << ns / (2 * events);
+        if (groups[g]) {
+            journal.close();
+            Fleet restarted(AVL);
+            Timer recovering;
+            journal.recover(restarted, snapshotPath, journalPath);
+            double recoverNs = recovering.elapsedNs();
+            journal.close();
+            cout << " (recover " << recoverNs / 1e6 << " ms" << (restarted.size() == fleet.size() ? "" : ", mismatch") << ")";
+        }
+        cout << endl;
+    }
+    std::remove(snapshotPath);
+    std::remove(journalPath);
+}
+
+// Dumping and exporting a large fleet into a string stream: the old
+// recursive per-token dump versus the buffered sink, plus both exports
+void benchDump() {
+    const int count = 90000;
+    const int rounds = 10;
+    vector<int> ids = shuffledIDs(count);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i], static_cast<SHIPTYPE>(i % 5), (i % 7) ? ALIVE : LOST));
+    cout << "\nDump and export of " << count << " ships, ns/ship:\n";
+    size_t bytes = 0;
+    Timer recursive;
+    for (int r = 0; r < rounds; r++) {
+        ostringstream out;
+        Tester::recursiveDump(Tester::root(fleet), out);
+        bytes += out.str().size();
+    }
+    report("recursive <<", recursive.elapsedNs(), size_t(rounds) * count);
+    Timer buffered;
+    for (int r = 0; r < rounds; r++) {
+        ostringstream out;
+        fleet.dumpTree(out);
+        bytes += out.str().size();
+    }
+    report("sink dump", buffered.elapsedNs(), size_t(rounds) * count);
+    const EXPORTFORMAT formats[] = {CSV, JSONL};
+    const char* names[] = {"CSV export", "JSONL export"};
+    for (int f = 0; f < 2; f++) {
+        Timer exporting;
+        for (int r = 0; r < rounds; r++) {
+            ostringstream out;
+            fleet.exportShips(out, formats[f]);
+            bytes += out.str().size();
+        }
+        report(names[f], exporting.elapsedNs(), size_t(rounds) * count);
+    }
+    g_sink += bytes;
+}
+
+// Handing a consistent view to readers: a deep copy with operator= versus
+// an O(1) snapshot(), then the cost of state updates when a snapshot is
+// taken (and the previous one dropped) every 'interval' updates
+void benchVersions() {
+    const int count = 90000;
+    const int rounds = 20;
+    vector<int> ids = shuffledIDs(count);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    cout << "\nViews of " << count << " ships:\n";
+    Timer copying;
+    for (int r = 0; r < rounds; r++) {
+        Fleet copy(AVL);
+        copy = fleet;
+        g_sink += copy.size();
+    }
+    cout << "  operator= " << copying.elapsedNs() / rounds / 1e3 << " us";
+    Timer snapshotting;
+    for (int r = 0; r < rounds; r++) g_sink += fleet.snapshot()->size();
+    cout << ", snapshot() " << snapshotting.elapsedNs() / rounds / 1e3 << " us" << endl;
+
+    std::mt19937 gen(80);
+    vector<int> targets;
+    for (int i = 0; i < 200000; i++) targets.push_back(ids[gen() % count]);
+    cout << "  updateState ns/op by snapshot interval (never / 1000 / 100 / 10):";
+    const size_t intervals[] = {0, 1000, 100, 10};
+    for (size_t k = 0; k < 4; k++) {
+        std::shared_ptr<const FleetVersion> version;
+        Timer timer;
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (intervals[k] && i % intervals[k] == 0) version = fleet.snapshot();
+            fleet.updateState(targets[i], (i % 2) ? ALIVE : LOST);
+        }
+        cout << " " << timer.elapsedNs() / targets.size();
+        if (k == 3) cout << " (pool " << Tester::poolLive(fleet) << " nodes)";
+    }
+    cout << endl;
+}
+
+// Reconciling a fleet of n ships with m registry ships: per-ID lookups and
+// inserts/removes versus merge and difference, with n fixed and m growing
+void benchSetOps() {
+    const int count = 90000;
+    vector<int> ids = shuffledIDs(count);
+    Fleet base(AVL);
+    for (int i = 0; i < count / 2; i++) base.insert(Ship(ids[i]));
+    cout << "\nSet operations on " << count / 2 << " ships, ms (per-ID loop / merge or difference), m registry ships:\n";
+    const int sizes[] = {100, 1000, 10000, 45000};
+    for (int k = 0; k < 4; k++) {
+        // Half of the registry is already in the fleet
+        Fleet registry(AVL);
+        for (int i = 0; i < sizes[k]; i++) registry.insert(Ship(ids[count / 2 - sizes[k] / 2 + i]));
+        vector<int> registryIDs;
+        registry.forEachInRange(MINID, MAXID, [&registryIDs](const Ship& ship) {registryIDs.push_back(ship.getID());});
+        cout << "  m=" << sizes[k] << ":";
+        for (int op = 0; op < 2; op++) {
+            Fleet looped(AVL), joined(AVL);
+            looped = base;
+            joined = base;
+            Timer loop;
+            for (size_t i = 0; i < registryIDs.size(); i++) {
+                if (op == 0 && !looped.contains(registryIDs[i])) looped.insert(Ship(registryIDs[i]));
+                if (op == 1 && looped.contains(registryIDs[i])) looped.remove(registryIDs[i]);
+            }
+            double loopNs = loop.elapsedNs();
+            Timer join;
+            if (op == 0) joined.merge(registry, 1);
+            else joined.difference(registry, 1);
+            double joinNs = join.elapsedNs();
+            cout << (op == 0 ? " merge " : ", difference ") << loopNs / 1e6 << " / " << joinNs / 1e6;
+            if (looped.size() != joined.size()) cout << " (mismatch)";
+        }
+        cout << endl;
+    }
+    // Two large fleets, single-threaded and with a thread per core
+    Fleet other(AVL);
+    for (int i = count / 4; i < count; i++) other.insert(Ship(ids[i]));
+    Fleet serial(AVL), parallel(AVL);
+    serial = base;
+    parallel = base;
+    Timer one;
+    serial.merge(other, 1);
+    double oneNs = one.elapsedNs();
+    Timer all;
+    parallel.merge(other);
+    cout << "  merge of " << other.size() << " ships: 1 thread " << oneNs / 1e6 << " ms, "
+         << std::max(1u, std::thread::hardware_concurrency()) << " threads " << all.elapsedNs() / 1e6 << " ms" << endl;
+}
+
+// Counters and tree shape after the same inserts and lookups on each tree
+// type: random IDs, then sorted IDs
+void benchStats() {
+    const TREETYPE types[] = {BST, AVL, SPLAY};
+    const char* names[] = {"BST", "AVL", "SPLAY"};
+    cout << "\nStats after inserts and lookups (rot/ins = rotations per insert, steps/op = splay steps per operation):\n";
+#ifndef FLEET_STATS
+    cout << "  (build with -DFLEET_STATS to fill in the counters)\n";
+#endif
+    for (int order = 0; order < 2; order++) {
+        const int count = (order == 0) ? 50000 : 5000; // A sorted BST is a list
+        vector<int> ids = shuffledIDs(count);
+        if (order == 1) sort(ids.begin(), ids.end());
+        for (int t = 0; t < 3; t++) {
+            Fleet fleet(types[t]);
+            for (int i = 0; i < count; i++) fleet.insert(Ship(ids[i]));
+            FleetStats inserted = fleet.stats();
+            fleet.resetStats();
+            for (int i = 0; i < count; i++) g_sink += fleet.contains(ids[(i * 7919) % count]);
+            FleetStats looked = fleet.stats();
+            double depthSum = 0;
+            for (size_t d = 0; d < looked.depths.size(); d++) depthSum += double(d) * looked.depths[d];
+            cout << "  " << names[t] << (order == 0 ? " random " : " sorted ") << count << ": height " << looked.height
+                 << ", mean depth " << depthSum / count << ", cmp/lookup "
+                 << double(looked.lookupComparisons) / max(1ul, looked.lookups) << ", rot/ins "
+                 << double(inserted.rotations) / count << ", steps/op "
+                 << double(inserted.splaySteps + looked.splaySteps) / (2 * count) << ", allocations "
+                 << inserted.allocations << endl;
+        }
+    }
+}
+
+// Inserts, lookups and removes of the same IDs, timed for one engine
+template <class FleetType>
+static void timeEngine(FleetType& fleet, const vector<int>& ids, double ns[3]) {
+    Timer insert;
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    ns[0] = insert.elapsedNs() / ids.size();
+    Timer lookup;
+    for (size_t i = 0; i < ids.size(); i++) g_sink += fleet.contains(ids[(i * 7919) % ids.size()]);
+    ns[1] = lookup.elapsedNs() / ids.size();
+    Timer remove;
+    for (size_t i = 0; i < ids.size(); i++) fleet.remove(ids[(i * 104729) % ids.size()]);
+    ns[2] = remove.elapsedNs() / ids.size();
+}
+
+// Runtime TREETYPE dispatch on 64-byte Ships versus the compile-time
+// engines on 24-byte nodes
+void benchPolicy() {
+    vector<int> ids = shuffledIDs(50000);
+    const char* names[] = {"BST", "AVL", "SPLAY"};
+    cout << "\nFleet versus BasicFleet, " << ids.size() << " random IDs, ns/op (Fleet / BasicFleet):\n";
+    for (int t = 0; t < 3; t++) {
+        double dispatched[3], basic[3];
+        Fleet fleet(t == 0 ? BST : t == 1 ? AVL : SPLAY);
+        timeEngine(fleet, ids, dispatched);
+        if (t == 0) {
+            BasicFleet<BSTPolicy> engine;
+            timeEngine(engine, ids, basic);
+        } else if (t == 1) {
+            BasicFleet<AVLPolicy> engine;
+            timeEngine(engine, ids, basic);
+        } else {
+            BasicFleet<SplayPolicy> engine;
+            timeEngine(engine, ids, basic);
+        }
+        cout << "  " << names[t] << ": insert " << dispatched[0] << " / " << basic[0] << ", lookup " << dispatched[1]
+             << " / " << basic[1] << ", remove " << dispatched[2] << " / " << basic[2] << endl;
+    }
+}
+
+// The B+-tree layout against the AVL tree and the DENSE table: 32 sorted
+// keys per node turn a lookup into a few SIMD-searched nodes, and scans walk
+// the leaf chain instead of chasing child links
+void benchBTree() {
+    const int count = 90000;
+    const int queries = 2000;
+    const int width = 1000;
+    vector<int> ids = shuffledIDs(count);
+    vector<int> probes = shuffledIDs(MAXID - MINID + 1, 13);
+    std::mt19937 gen(20);
+    vector<int> starts;
+    for (int q = 0; q < queries; q++) starts.push_back(MINID + gen() % (MAXID - MINID + 1 - width));
+    cout << "\nBTREE vs AVL and DENSE, " << count << " ships (insert / find / ordered walk / range of " << width
+         << " / remove, ns per op, ship or query):\n";
+    const TREETYPE types[] = {AVL, DENSE, BTREE};
+    const char* names[] = {"AVL", "DENSE", "BTREE"};
+    for (int t = 0; t < 3; t++) {
+        Fleet fleet(types[t]);
+        Timer insertTimer;
+        for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+        double insertNs = insertTimer.elapsedNs();
+        Timer findTimer;
+        for (size_t i = 0; i < probes.size(); i++) g_sink += fleet.contains(probes[i]);
+        double findNs = findTimer.elapsedNs();
+        Timer walkTimer;
+        g_sink += Tester::orderedSum(fleet);
+        double walkNs = walkTimer.elapsedNs();
+        long sum = 0;
+        Timer rangeTimer;
+        for (int q = 0; q < queries; q++)
+            fleet.forEachInRange(starts[q], starts[q] + width, [&sum](const Ship& ship) { sum += ship.getID(); });
+        double rangeNs = rangeTimer.elapsedNs();
+        g_sink += sum;
+        Timer removeTimer;
+        for (size_t i = 0; i < ids.size(); i++) fleet.remove(ids[i]);
+        double removeNs = removeTimer.elapsedNs();
+        cout << "  " << names[t] << ": " << insertNs / count << " / " << findNs / probes.size() << " / "
+             << walkNs / count << " / " << rangeNs / queries << " / " << removeNs / count << endl;
+    }
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++) fleet.insert(Ship(ids[i]));
+    Timer toTable;
+    fleet.setType(BTREE);
+    double toTableNs = toTable.elapsedNs();
+    Timer toTree;
+    fleet.setType(AVL);
+    cout << "  setType AVL->BTREE: " << toTableNs / 1e6 << " ms, BTREE->AVL: " << toTree.elapsedNs() / 1e6 << " ms" << endl;
+}
+
+// "All LOST ROBOCARRIERs": walking the tree and testing every node versus
+// scanning the type and state columns, with the scalar and AVX2 kernels
+void benchColumns() {
+    const int count = 90000;
+    const int queries = 200;
+    vector<int> ids = shuffledIDs(count);
+    Fleet fleet(AVL);
+    for (size_t i = 0; i < ids.size(); i++)
+        fleet.insert(Ship(ids[i], static_cast<SHIPTYPE>(ids[i] % SHIPTYPES), (ids[i] % 7) ? ALIVE : LOST));
+    Timer build;
+    std::shared_ptr<const FleetColumns> columns = fleet.columns();
+    double buildNs = build.elapsedNs();
+    long sum = 0;
+    vector<int> found;
+    Timer walkCount;
+    for (int q = 0; q < queries; q++)
+        fleet.forEachInRange(MINID, MAXID, [&sum](const Ship& ship) { sum += (ship.getType() == ROBOCARRIER && ship.getState() == LOST); });
+    double walkCountNs = walkCount.elapsedNs() / queries;
+    Timer walkSelect;
+    for (int q = 0; q < queries; q++) {
+        found.clear();
+        fleet.forEachInRange(MINID, MAXID, [&found](const Ship& ship) {
+            if (ship.getType() == ROBOCARRIER && ship.getState() == LOST) found.push_back(ship.getID());
+        });
+    }
+    double walkSelectNs = walkSelect.elapsedNs() / queries;
+    cout << "\nColumn filters, " << count << " ships, LOST ROBOCARRIERs, us per query (count / ID list):\n";
+    cout << "  tree walk: " << walkCountNs / 1e3 << " / " << walkSelectNs / 1e3 << endl;
+    bool simd = FleetColumns::vectorized();
+    for (int kernel = 0; kernel < (simd ? 2 : 1); kernel++) {
+        FleetColumns::vectorize(kernel == 1);
+        Timer scanCount;
+        for (int q = 0; q < queries; q++) sum += columns->count(ROBOCARRIER, LOST);
+        double scanCountNs = scanCount.elapsedNs() / queries;
+        Timer scanSelect;
+        for (int q = 0; q < queries; q++) {
+            found.clear();
+            columns->select(ROBOCARRIER, LOST, found);
+        }
+        double scanSelectNs = scanSelect.elapsedNs() / queries;
+        cout << "  columns, " << (kernel ? "AVX2" : "scalar") << ": " << scanCountNs / 1e3 << " / " << scanSelectNs / 1e3 << endl;
+    }
+    FleetColumns::vectorize(true);
+    g_sink += sum + found.size();
+    cout << "  building the columns: " << buildNs / 1e3 << " us" << endl;
+}
+
+struct Section {
+    const char* name;
+    void (*run)();
+};
+
+static const Section SECTIONS[] = {
+    {"pool", benchPool},
+    {"insert", benchInsert},
+    {"shapes", benchShapes},
+    {"lookup", benchLookup},
+    {"dense", benchDense},
+    {"bulk", benchBulk},
+    {"compact", benchCompact},
+    {"snapshot", benchSnapshot},
+    {"concurrent", benchConcurrent},
+    {"sharded", benchSharded},
+    {"range", benchRange},
+    {"order", benchOrder},
+    {"totals", benchTotals},
+    {"batch", benchBatch},
+    {"update", benchUpdate},
+    {"restart", benchRestart},
+    {"journal", benchJournal},
+    {"dump", benchDump},
+    {"versions", benchVersions},
+    {"setops", benchSetOps},
+    {"stats", benchStats},
+    {"policy", benchPolicy},
+    {"btree", benchBTree},
+    {"columns", benchColumns},
+};
+
+int main(int argc, char** argv) {
+    for (const Section& section : SECTIONS) {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc; i++)
+            if (strcmp(argv[i], section.name) == 0) selected = true;
+        if (selected) section.run();
+    }
+    return 0;
+}
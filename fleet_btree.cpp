@@ -0,0 +1,548 @@
+#include "fleet.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#if defined(__AVX2__) && !defined(FLEET_NO_SIMD)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(FLEET_NO_SIMD)
+#include <emmintrin.h>
+#endif
+
+// Number of keys below id in a full node key array. Unused slots hold
+// INT_MAX and never count, so every node is searched the same way. The keys
+// are sorted, so the lanes below id form a prefix of the compare mask and
+// the count is its first clear bit.
+int BTreeTable::countBelow(const int32_t* keys, int id) {
+#if defined(__AVX2__) && !defined(FLEET_NO_SIMD)
+    __m256i probe = _mm256_set1_epi32(id);
+    uint64_t mask = 0;
+    for (int i = 0; i < KEYS; i += 8) {
+        __m256i less = _mm256_cmpgt_epi32(probe, _mm256_load_si256(reinterpret_cast<const __m256i*>(keys + i)));
+        mask |= uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(less))) << i;
+    }
+    return __builtin_ctzll(~mask);
+#elif defined(__SSE2__) && !defined(FLEET_NO_SIMD)
+    __m128i probe = _mm_set1_epi32(id);
+    uint64_t mask = 0;
+    for (int i = 0; i < KEYS; i += 4) {
+        __m128i less = _mm_cmpgt_epi32(probe, _mm_load_si128(reinterpret_cast<const __m128i*>(keys + i)));
+        mask |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(less))) << i;
+    }
+    return __builtin_ctzll(~mask);
+#else
+    int below = 0;
+    for (int i = 0; i < KEYS; i++) below += keys[i] < id;
+    return below;
+#endif
+}
+
+// Empty tree, the first insert creates the root leaf
+BTreeTable::BTreeTable() {
+    m_root = nullptr;
+    m_first = m_last = nullptr;
+    m_levels = 0;
+    m_count = 0;
+    m_totals = FleetTotals();
+}
+
+// Deep copy, rebuilt from the other tree's leaves
+BTreeTable::BTreeTable(const BTreeTable& rhs) {
+    m_root = nullptr;
+    m_first = m_last = nullptr;
+    m_levels = 0;
+    m_count = 0;
+    m_totals = FleetTotals();
+    *this = rhs;
+}
+
+BTreeTable& BTreeTable::operator=(const BTreeTable& rhs) {
+    if (this == &rhs) return *this;
+    vector<int> ids;
+    vector<unsigned char> payload;
+    ids.reserve(rhs.m_count);
+    payload.reserve(rhs.m_count);
+    for (const Leaf* leaf = rhs.m_first; leaf; leaf = leaf->next) {
+        ids.insert(ids.end(), leaf->keys, leaf->keys + leaf->count);
+        payload.insert(payload.end(), leaf->payload, leaf->payload + leaf->count);
+    }
+    build(ids.data(), payload.data(), ids.size());
+    return *this;
+}
+
+BTreeTable::~BTreeTable() {
+    clear();
+}
+
+void BTreeTable::freeNode(Node* node) {
+    if (node->leaf) {
+        delete static_cast<Leaf*>(node);
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for (int i = 0; i < inner->count; i++) freeNode(inner->children[i]);
+    delete inner;
+}
+
+void BTreeTable::clear() {
+    if (m_root) freeNode(m_root);
+    m_root = nullptr;
+    m_first = m_last = nullptr;
+    m_levels = 0;
+    m_count = 0;
+    m_totals = FleetTotals();
+}
+
+// Adds or removes one ship of this type and state from the totals
+void BTreeTable::count(unsigned char payload, int delta) {
+    m_totals.ships += delta;
+    m_totals.byType[payload & 7] += delta;
+    m_totals.byState[payload >> 3] += delta;
+}
+
+// Leaf whose key range holds id, or null when empty
+const BTreeTable::Leaf* BTreeTable::findLeaf(int id) const {
+    const Node* node = m_root;
+    if (!node) return nullptr;
+    while (!node->leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        // Separators equal to id lead right, to the child starting there
+        node = inner->children[countBelow(inner->keys, id == INT_MAX ? id : id + 1)];
+    }
+    return static_cast<const Leaf*>(node);
+}
+
+// findLeaf recording the inner nodes and the child taken at each
+BTreeTable::Leaf* BTreeTable::descend(int id, Step* path, int& depth) const {
+    Node* node = m_root;
+    depth = 0;
+    while (!node->leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        int child = countBelow(inner->keys, id == INT_MAX ? id : id + 1);
+        path[depth].node = inner;
+        path[depth].child = child;
+        depth++;
+        node = inner->children[child];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+bool BTreeTable::contains(int id) const {
+    const Leaf* leaf = findLeaf(id);
+    if (!leaf) return false;
+    int i = countBelow(leaf->keys, id);
+    return i < leaf->count && leaf->keys[i] == id;
+}
+
+bool BTreeTable::get(int id, Ship& out) const {
+    const Leaf* leaf = findLeaf(id);
+    if (!leaf) return false;
+    int i = countBelow(leaf->keys, id);
+    if (i == leaf->count || leaf->keys[i] != id) return false;
+    out = Ship(id, static_cast<SHIPTYPE>(leaf->payload[i] & 7), static_cast<STATE>(leaf->payload[i] >> 3));
+    return true;
+}
+
+// Inserts into its leaf; a full leaf splits in half and hands a separator
+// and the new right node to its parent, which may split in turn
+bool BTreeTable::insert(int id, SHIPTYPE type, STATE state) {
+    unsigned char packed = pack(type, state);
+    if (!m_root) {
+        Leaf* leaf = new Leaf;
+        std::fill(leaf->keys, leaf->keys + KEYS, INT_MAX);
+        leaf->keys[0] = id;
+        leaf->payload[0] = packed;
+        leaf->count = 1;
+        leaf->leaf = true;
+        leaf->prev = leaf->next = nullptr;
+        m_root = m_first = m_last = leaf;
+        m_levels = 1;
+        m_count = 1;
+        count(packed, 1);
+        return true;
+    }
+    Step path[MAX_LEVELS];
+    int depth;
+    Leaf* leaf = descend(id, path, depth);
+    int at = countBelow(leaf->keys, id);
+    if (at < leaf->count && leaf->keys[at] == id) return false;
+    for (int d = 0; d < depth; d++) path[d].node->sizes[path[d].child]++;
+    m_count++;
+    count(packed, 1);
+
+    if (leaf->count < KEYS) {
+        memmove(leaf->keys + at + 1, leaf->keys + at, (leaf->count - at) * sizeof(int32_t));
+        memmove(leaf->payload + at + 1, leaf->payload + at, leaf->count - at);
+        leaf->keys[at] = id;
+        leaf->payload[at] = packed;
+        leaf->count++;
+        return true;
+    }
+
+    // Split the full leaf around the new key
+    int32_t keys[KEYS + 1];
+    unsigned char payload[KEYS + 1];
+    memcpy(keys, leaf->keys, at * sizeof(int32_t));
+    memcpy(payload, leaf->payload, at);
+    keys[at] = id;
+    payload[at] = packed;
+    memcpy(keys + at + 1, leaf->keys + at, (KEYS - at) * sizeof(int32_t));
+    memcpy(payload + at + 1, leaf->payload + at, KEYS - at);
+    Leaf* right = new Leaf;
+    right->leaf = true;
+    int half = (KEYS + 1) / 2;
+    std::fill(leaf->keys, leaf->keys + KEYS, INT_MAX);
+    std::fill(right->keys, right->keys + KEYS, INT_MAX);
+    memcpy(leaf->keys, keys, half * sizeof(int32_t));
+    memcpy(leaf->payload, payload, half);
+    memcpy(right->keys, keys + half, (KEYS + 1 - half) * sizeof(int32_t));
+    memcpy(right->payload, payload + half, KEYS + 1 - half);
+    leaf->count = half;
+    right->count = KEYS + 1 - half;
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next) leaf->next->prev = right;
+    else m_last = right;
+    leaf->next = right;
+
+    int separator = right->keys[0];
+    Node* added = right;
+    uint32_t leftSize = leaf->count, addedSize = right->count;
+    for (int d = depth - 1; d >= 0; d--) {
+        Inner* parent = path[d].node;
+        int child = path[d].child;
+        parent->sizes[child] = leftSize;
+        if (parent->count < KEYS + 1) {
+            memmove(parent->keys + child + 1, parent->keys + child, (parent->count - 1 - child) * sizeof(int32_t));
+            memmove(parent->children + child + 2, parent->children + child + 1, (parent->count - 1 - child) * sizeof(Node*));
+            memmove(parent->sizes + child + 2, parent->sizes + child + 1, (parent->count - 1 - child) * sizeof(uint32_t));
+            parent->keys[child] = separator;
+            parent->children[child + 1] = added;
+            parent->sizes[child + 1] = addedSize;
+            parent->count++;
+            return true;
+        }
+        // Split the full inner node; the middle separator moves up
+        int32_t innerKeys[KEYS + 1];
+        Node* children[KEYS + 2];
+        uint32_t sizes[KEYS + 2];
+        memcpy(innerKeys, parent->keys, child * sizeof(int32_t));
+        innerKeys[child] = separator;
+        memcpy(innerKeys + child + 1, parent->keys + child, (KEYS - child) * sizeof(int32_t));
+        memcpy(children, parent->children, (child + 1) * sizeof(Node*));
+        memcpy(sizes, parent->sizes, (child + 1) * sizeof(uint32_t));
+        children[child + 1] = added;
+        sizes[child + 1] = addedSize;
+        memcpy(children + child + 2, parent->children + child + 1, (KEYS - child) * sizeof(Node*));
+        memcpy(sizes + child + 2, parent->sizes + child + 1, (KEYS - child) * sizeof(uint32_t));
+
+        Inner* sibling = new Inner;
+        sibling->leaf = false;
+        int leftChildren = (KEYS + 2) / 2;
+        int rightChildren = KEYS + 2 - leftChildren;
+        std::fill(parent->keys, parent->keys + KEYS, INT_MAX);
+        std::fill(sibling->keys, sibling->keys + KEYS, INT_MAX);
+        memcpy(parent->keys, innerKeys, (leftChildren - 1) * sizeof(int32_t));
+        memcpy(parent->children, children, leftChildren * sizeof(Node*));
+        memcpy(parent->sizes, sizes, leftChildren * sizeof(uint32_t));
+        memcpy(sibling->keys, innerKeys + leftChildren, (rightChildren - 1) * sizeof(int32_t));
+        memcpy(sibling->children, children + leftChildren, rightChildren * sizeof(Node*));
+        memcpy(sibling->sizes, sizes + leftChildren, rightChildren * sizeof(uint32_t));
+        parent->count = leftChildren;
+        sibling->count = rightChildren;
+        separator = innerKeys[leftChildren - 1];
+        added = sibling;
+        leftSize = addedSize = 0;
+        for (int i = 0; i < leftChildren; i++) leftSize += parent->sizes[i];
+        for (int i = 0; i < rightChildren; i++) addedSize += sibling->sizes[i];
+    }
+    // The root split: a new root above the two halves
+    Inner* root = new Inner;
+    root->leaf = false;
+    std::fill(root->keys, root->keys + KEYS, INT_MAX);
+    root->keys[0] = separator;
+    root->children[0] = m_root;
+    root->children[1] = added;
+    root->sizes[0] = leftSize;
+    root->sizes[1] = addedSize;
+    root->count = 2;
+    m_root = root;
+    m_levels++;
+    return true;
+}
+
+// Removes from its leaf; a leaf or inner node left below half full borrows
+// from a sibling or merges with it, which may leave the parent short
+bool BTreeTable::remove(int id) {
+    if (!m_root) return false;
+    Step path[MAX_LEVELS];
+    int depth;
+    Leaf* leaf = descend(id, path, depth);
+    int at = countBelow(leaf->keys, id);
+    if (at == leaf->count || leaf->keys[at] != id) return false;
+    for (int d = 0; d < depth; d++) path[d].node->sizes[path[d].child]--;
+    m_count--;
+    count(leaf->payload[at], -1);
+    memmove(leaf->keys + at, leaf->keys + at + 1, (leaf->count - at - 1) * sizeof(int32_t));
+    memmove(leaf->payload + at, leaf->payload + at + 1, leaf->count - at - 1);
+    leaf->count--;
+    leaf->keys[leaf->count] = INT_MAX;
+
+    if (depth == 0) {
+        if (leaf->count == 0) clear();
+        return true;
+    }
+    if (leaf->count >= MIN_KEYS) return true;
+    fixLeaf(leaf, path, depth);
+    return true;
+}
+
+// Refills a leaf below MIN_KEYS from a sibling under the same parent
+void BTreeTable::fixLeaf(Leaf* leaf, Step* path, int depth) {
+    Inner* parent = path[depth - 1].node;
+    int child = path[depth - 1].child;
+    Leaf* left = (child > 0) ? static_cast<Leaf*>(parent->children[child - 1]) : nullptr;
+    Leaf* right = (child + 1 < parent->count) ? static_cast<Leaf*>(parent->children[child + 1]) : nullptr;
+    if (left && left->count > MIN_KEYS) {
+        // The left sibling's largest ship moves over
+        memmove(leaf->keys + 1, leaf->keys, leaf->count * sizeof(int32_t));
+        memmove(leaf->payload + 1, leaf->payload, leaf->count);
+        left->count--;
+        leaf->keys[0] = left->keys[left->count];
+        leaf->payload[0] = left->payload[left->count];
+        left->keys[left->count] = INT_MAX;
+        leaf->count++;
+        parent->keys[child - 1] = leaf->keys[0];
+        parent->sizes[child - 1]--;
+        parent->sizes[child]++;
+        return;
+    }
+    if (right && right->count > MIN_KEYS) {
+        // The right sibling's smallest ship moves over
+        leaf->keys[leaf->count] = right->keys[0];
+        leaf->payload[leaf->count] = right->payload[0];
+        leaf->count++;
+        right->count--;
+        memmove(right->keys, right->keys + 1, right->count * sizeof(int32_t));
+        memmove(right->payload, right->payload + 1, right->count);
+        right->keys[right->count] = INT_MAX;
+        parent->keys[child] = right->keys[0];
+        parent->sizes[child]++;
+        parent->sizes[child + 1]--;
+        return;
+    }
+    // Merge with a sibling: the right one of the pair empties into the left
+    int at = left ? child - 1 : child;
+    Leaf* into = static_cast<Leaf*>(parent->children[at]);
+    Leaf* from = static_cast<Leaf*>(parent->children[at + 1]);
+    memcpy(into->keys + into->count, from->keys, from->count * sizeof(int32_t));
+    memcpy(into->payload + into->count, from->payload, from->count);
+    into->count += from->count;
+    into->next = from->next;
+    if (from->next) from->next->prev = into;
+    else m_last = into;
+    delete from;
+    parent->sizes[at] += parent->sizes[at + 1];
+    memmove(parent->keys + at, parent->keys + at + 1, (parent->count - 2 - at) * sizeof(int32_t));
+    memmove(parent->children + at + 1, parent->children + at + 2, (parent->count - 2 - at) * sizeof(Node*));
+    memmove(parent->sizes + at + 1, parent->sizes + at + 2, (parent->count - 2 - at) * sizeof(uint32_t));
+    parent->count--;
+    parent->keys[parent->count - 1] = INT_MAX;
+    fixInner(parent, path, depth - 1);
+}
+
+// Refills an inner node below MIN_CHILDREN after a merge below it; the
+// separator in the grandparent rotates through when borrowing. A root left
+// with one child is replaced by it.
+void BTreeTable::fixInner(Inner* node, Step* path, int depth) {
+    if (depth == 0) {
+        if (node->count == 1) {
+            m_root = node->children[0];
+            m_levels--;
+            delete node;
+        }
+        return;
+    }
+    if (node->count >= MIN_CHILDREN) return;
+    Inner* parent = path[depth - 1].node;
+    int child = path[depth - 1].child;
+    Inner* left = (child > 0) ? static_cast<Inner*>(parent->children[child - 1]) : nullptr;
+    Inner* right = (child + 1 < parent->count) ? static_cast<Inner*>(parent->children[child + 1]) : nullptr;
+    if (left && left->count > MIN_CHILDREN) {
+        memmove(node->keys + 1, node->keys, (node->count - 1) * sizeof(int32_t));
+        memmove(node->children + 1, node->children, node->count * sizeof(Node*));
+        memmove(node->sizes + 1, node->sizes, node->count * sizeof(uint32_t));
+        node->keys[0] = parent->keys[child - 1];
+        node->children[0] = left->children[left->count - 1];
+        node->sizes[0] = left->sizes[left->count - 1];
+        node->count++;
+        parent->keys[child - 1] = left->keys[left->count - 2];
+        parent->sizes[child - 1] -= node->sizes[0];
+        parent->sizes[child] += node->sizes[0];
+        left->keys[left->count - 2] = INT_MAX;
+        left->count--;
+        return;
+    }
+    if (right && right->count > MIN_CHILDREN) {
+        node->keys[node->count - 1] = parent->keys[child];
+        node->children[node->count] = right->children[0];
+        node->sizes[node->count] = right->sizes[0];
+        node->count++;
+        parent->keys[child] = right->keys[0];
+        parent->sizes[child] += right->sizes[0];
+        parent->sizes[child + 1] -= right->sizes[0];
+        memmove(right->keys, right->keys + 1, (right->count - 2) * sizeof(int32_t));
+        memmove(right->children, right->children + 1, (right->count - 1) * sizeof(Node*));
+        memmove(right->sizes, right->sizes + 1, (right->count - 1) * sizeof(uint32_t));
+        right->count--;
+        right->keys[right->count - 1] = INT_MAX;
+        return;
+    }
+    // Merge: the separator comes down between the two key runs
+    int at = left ? child - 1 : child;
+    Inner* into = static_cast<Inner*>(parent->children[at]);
+    Inner* from = static_cast<Inner*>(parent->children[at + 1]);
+    into->keys[into->count - 1] = parent->keys[at];
+    memcpy(into->keys + into->count, from->keys, (from->count - 1) * sizeof(int32_t));
+    memcpy(into->children + into->count, from->children, from->count * sizeof(Node*));
+    memcpy(into->sizes + into->count, from->sizes, from->count * sizeof(uint32_t));
+    into->count += from->count;
+    delete from;
+    parent->sizes[at] += parent->sizes[at + 1];
+    memmove(parent->keys + at, parent->keys + at + 1, (parent->count - 2 - at) * sizeof(int32_t));
+    memmove(parent->children + at + 1, parent->children + at + 2, (parent->count - 2 - at) * sizeof(Node*));
+    memmove(parent->sizes + at + 1, parent->sizes + at + 2, (parent->count - 2 - at) * sizeof(uint32_t));
+    parent->count--;
+    parent->keys[parent->count - 1] = INT_MAX;
+    fixInner(parent, path, depth - 1);
+}
+
+int BTreeTable::next(int id) const {
+    const Leaf* leaf = findLeaf(id);
+    if (!leaf) return -1;
+    int i = countBelow(leaf->keys, id);
+    if (i < leaf->count) return leaf->keys[i];
+    return leaf->next ? leaf->next->keys[0] : -1;
+}
+
+int BTreeTable::prev(int id) const {
+    const Leaf* leaf = findLeaf(id);
+    if (!leaf) return -1;
+    int i = countBelow(leaf->keys, id == INT_MAX ? id : id + 1);
+    if (i > 0) return leaf->keys[i - 1];
+    return leaf->prev ? leaf->prev->keys[leaf->prev->count - 1] : -1;
+}
+
+// Adds up the sizes of the children left of the descent
+size_t BTreeTable::rank(int id) const {
+    const Node* node = m_root;
+    if (!node) return 0;
+    size_t below = 0;
+    while (!node->leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        int child = countBelow(inner->keys, id);
+        for (int i = 0; i < child; i++) below += inner->sizes[i];
+        node = inner->children[child];
+    }
+    return below + countBelow(node->keys, id);
+}
+
+// Descends by the child sizes
+int BTreeTable::select(size_t k) const {
+    if (k >= m_count) return -1;
+    const Node* node = m_root;
+    while (!node->leaf) {
+        const Inner* inner = static_cast<const Inner*>(node);
+        int child = 0;
+        while (k >= inner->sizes[child]) k -= inner->sizes[child++];
+        node = inner->children[child];
+    }
+    return node->keys[k];
+}
+
+FleetTotals BTreeTable::totalsInRange(int lo, int hi) const {
+    FleetTotals totals = FleetTotals();
+    forEach(lo, hi, [&totals](int, SHIPTYPE type, STATE state) {
+        totals.ships++;
+        totals.byType[type]++;
+        totals.byState[state]++;
+    });
+    return totals;
+}
+
+bool BTreeTable::retag(int id, SHIPTYPE type, STATE state) {
+    Leaf* leaf = const_cast<Leaf*>(findLeaf(id));
+    if (!leaf) return false;
+    int i = countBelow(leaf->keys, id);
+    if (i == leaf->count || leaf->keys[i] != id) return false;
+    count(leaf->payload[i], -1);
+    leaf->payload[i] = pack(type, state);
+    count(leaf->payload[i], 1);
+    return true;
+}
+
+// Cuts a sorted run into evenly filled groups of at most 'capacity', so
+// every group of a run longer than one node gets at least half of it
+static size_t groupSize(size_t n, size_t groups, size_t g) {
+    return n / groups + (g < n % groups ? 1 : 0);
+}
+
+void BTreeTable::build(const int* ids, const unsigned char* payload, size_t n) {
+    clear();
+    if (n == 0) return;
+    vector<Node*> level;
+    vector<int> lows;           // smallest ID under each node of the level
+    vector<uint32_t> sizes;     // ships under each node of the level
+    size_t leaves = (n + KEYS - 1) / KEYS;
+    Leaf* previous = nullptr;
+    for (size_t g = 0, start = 0; g < leaves; g++) {
+        size_t fill = groupSize(n, leaves, g);
+        Leaf* leaf = new Leaf;
+        leaf->leaf = true;
+        std::fill(leaf->keys, leaf->keys + KEYS, INT_MAX);
+        memcpy(leaf->keys, ids + start, fill * sizeof(int32_t));
+        memcpy(leaf->payload, payload + start, fill);
+        leaf->count = int(fill);
+        leaf->prev = previous;
+        leaf->next = nullptr;
+        if (previous) previous->next = leaf;
+        else m_first = leaf;
+        previous = leaf;
+        for (size_t i = 0; i < fill; i++) count(payload[start + i], 1);
+        level.push_back(leaf);
+        lows.push_back(ids[start]);
+        sizes.push_back(uint32_t(fill));
+        start += fill;
+    }
+    m_last = previous;
+    m_count = n;
+    m_levels = 1;
+    while (level.size() > 1) {
+        size_t parents = (level.size() + KEYS) / (KEYS + 1);
+        vector<Node*> upper;
+        vector<int> upperLows;
+        vector<uint32_t> upperSizes;
+        for (size_t g = 0, start = 0; g < parents; g++) {
+            size_t fill = groupSize(level.size(), parents, g);
+            Inner* inner = new Inner;
+            inner->leaf = false;
+            std::fill(inner->keys, inner->keys + KEYS, INT_MAX);
+            uint32_t total = 0;
+            for (size_t i = 0; i < fill; i++) {
+                inner->children[i] = level[start + i];
+                inner->sizes[i] = sizes[start + i];
+                if (i > 0) inner->keys[i - 1] = lows[start + i];
+                total += sizes[start + i];
+            }
+            inner->count = int(fill);
+            upper.push_back(inner);
+            upperLows.push_back(lows[start]);
+            upperSizes.push_back(total);
+            start += fill;
+        }
+        level.swap(upper);
+        lows.swap(upperLows);
+        sizes.swap(upperSizes);
+        m_levels++;
+    }
+    m_root = level[0];
+}
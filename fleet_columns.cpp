@@ -0,0 +1,148 @@
+#include "fleet_columns.h"
+#include <cstring>
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(FLEET_NO_SIMD)
+#define FLEET_COLUMNS_AVX2
+#include <immintrin.h>
+#endif
+
+static const size_t WORD_ROWS = 64;     // rows per mask word
+static const unsigned char PAD = 0xff;  // column byte of the padding rows
+
+// A filter value as a byte to compare and the bits that must agree. ANY
+// only checks the top bit, which every real type and state leaves clear and
+// the padding sets, so padding rows never match.
+struct ColumnKey{
+    unsigned char typeValue, typeCare, stateValue, stateCare;
+};
+
+// Scans whole 64-row words, writing each word's match bits to out (if
+// given); returns the number of matches
+typedef size_t (*ScanKernel)(const unsigned char* types, const unsigned char* states, size_t words,
+                             const ColumnKey& key, uint64_t* out);
+
+// Eight rows per step in a 64-bit word: a row matches when its miss byte is
+// zero, which leaves 0x01 in that byte of hits; a multiply gathers the eight
+// flags into one mask byte, another adds them up. Rows are loaded in host
+// (little-endian) byte order, as in fleet_file.h.
+static size_t scanScalar(const unsigned char* types, const unsigned char* states, size_t words,
+                         const ColumnKey& key, uint64_t* out) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+    const uint64_t gather = 0x0102040810204080ULL;
+    const uint64_t typeValue = key.typeValue * ones, typeCare = key.typeCare * ones;
+    const uint64_t stateValue = key.stateValue * ones, stateCare = key.stateCare * ones;
+    size_t matches = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = 0;
+        for (size_t j = 0; j < WORD_ROWS / 8; j++) {
+            uint64_t type, state;
+            memcpy(&type, types + w * WORD_ROWS + 8 * j, 8);
+            memcpy(&state, states + w * WORD_ROWS + 8 * j, 8);
+            uint64_t miss = ((type ^ typeValue) & typeCare) | ((state ^ stateValue) & stateCare);
+            uint64_t hits = ~(((miss & low7) + low7) | miss | low7) >> 7;
+            bits |= ((hits * gather) >> 56) << (8 * j);
+            matches += (hits * ones) >> 56;
+        }
+        if (out) out[w] = bits;
+    }
+    return matches;
+}
+
+#ifdef FLEET_COLUMNS_AVX2
+// Two 32-byte compares per column make one mask word. Compiled for AVX2
+// whatever the build targets; only called once the CPU reported support.
+__attribute__((target("avx2,popcnt")))
+static size_t scanAVX2(const unsigned char* types, const unsigned char* states, size_t words,
+                       const ColumnKey& key, uint64_t* out) {
+    const __m256i typeValue = _mm256_set1_epi8(static_cast<char>(key.typeValue));
+    const __m256i typeCare = _mm256_set1_epi8(static_cast<char>(key.typeCare));
+    const __m256i stateValue = _mm256_set1_epi8(static_cast<char>(key.stateValue));
+    const __m256i stateCare = _mm256_set1_epi8(static_cast<char>(key.stateCare));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t matches = 0;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t bits = 0;
+        for (size_t half = 0; half < 2; half++) {
+            size_t row = w * WORD_ROWS + half * 32;
+            __m256i type = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(types + row));
+            __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + row));
+            __m256i miss = _mm256_or_si256(_mm256_and_si256(_mm256_xor_si256(type, typeValue), typeCare),
+                                           _mm256_and_si256(_mm256_xor_si256(state, stateValue), stateCare));
+            uint32_t hits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(miss, zero)));
+            bits |= uint64_t(hits) << (half * 32);
+        }
+        if (out) out[w] = bits;
+        matches += _mm_popcnt_u64(bits);
+    }
+    return matches;
+}
+#endif
+
+// The AVX2 kernel if this CPU runs it, else the scalar one
+static ScanKernel bestKernel() {
+#ifdef FLEET_COLUMNS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return scanAVX2;
+#endif
+    return scanScalar;
+}
+
+static ScanKernel g_scan = bestKernel();
+
+// Encodes the filter; false if a value can never match
+static bool makeKey(int type, int state, ColumnKey& key) {
+    if (type != FleetColumns::ANY && (type < 0 || type >= SHIPTYPES)) return false;
+    if (state != FleetColumns::ANY && state != ALIVE && state != LOST) return false;
+    key.typeValue = static_cast<unsigned char>(type == FleetColumns::ANY ? 0 : type);
+    key.typeCare = (type == FleetColumns::ANY) ? 0x80 : 0xff;
+    key.stateValue = static_cast<unsigned char>(state == FleetColumns::ANY ? 0 : state);
+    key.stateCare = (state == FleetColumns::ANY) ? 0x80 : 0xff;
+    return true;
+}
+
+// Unpacks the payload into the type and state columns, padding both to
+// whole mask words
+FleetColumns::FleetColumns(const int* ids, const unsigned char* payload, size_t n)
+    : m_ids(ids, ids + n), m_size(n) {
+    size_t rows = (n + WORD_ROWS - 1) / WORD_ROWS * WORD_ROWS;
+    m_types.assign(rows, PAD);
+    m_states.assign(rows, PAD);
+    for (size_t i = 0; i < n; i++) {
+        m_types[i] = payload[i] & 7;
+        m_states[i] = payload[i] >> 3;
+    }
+}
+
+size_t FleetColumns::count(int type, int state) const {
+    ColumnKey key;
+    if (!makeKey(type, state, key)) return 0;
+    return g_scan(m_types.data(), m_states.data(), m_types.size() / WORD_ROWS, key, nullptr);
+}
+
+// Builds the mask, then walks its set bits lowest first
+size_t FleetColumns::select(int type, int state, vector<int>& out) const {
+    vector<uint64_t> bits;
+    size_t matches = mask(type, state, bits);
+    out.reserve(out.size() + matches);
+    for (size_t w = 0; w < bits.size(); w++) {
+        for (uint64_t word = bits[w]; word; word &= word - 1)
+            out.push_back(m_ids[w * WORD_ROWS + __builtin_ctzll(word)]);
+    }
+    return matches;
+}
+
+size_t FleetColumns::mask(int type, int state, vector<uint64_t>& bits) const {
+    size_t words = m_types.size() / WORD_ROWS;
+    bits.assign(words, 0);
+    ColumnKey key;
+    if (!makeKey(type, state, key)) return 0;
+    return g_scan(m_types.data(), m_states.data(), words, key, bits.data());
+}
+
+bool FleetColumns::vectorized() {
+    return g_scan != scanScalar;
+}
+
+void FleetColumns::vectorize(bool on) {
+    g_scan = on ? bestKernel() : scanScalar;
+}
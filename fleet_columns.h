@@ -0,0 +1,40 @@
+#ifndef FLEET_COLUMNS_H
+#define FLEET_COLUMNS_H
+#include "fleet.h"
+
+// Columnar copy of a fleet returned by Fleet::columns(): the IDs in ID order
+// and, row for row, one byte column each for type and state. Filters such as
+// "all LOST ROBOCARRIERs" scan the two byte columns 32 rows per compare
+// with AVX2 where the CPU has it, checked at run time, and with a scalar
+// loop otherwise; no tree node is touched. Columns never change after
+// construction and can be shared between reader threads.
+class FleetColumns{
+    public:
+    static const int ANY = -1;  // filter value matching every type or state
+    // ids must be sorted ascending, payload[i] packed with FleetSnapshot::pack()
+    FleetColumns(const int* ids, const unsigned char* payload, size_t n);
+    size_t size() const {return m_size;}
+    const int* ids() const {return m_ids.data();}   // row i holds the i-th smallest ID
+    SHIPTYPE type(size_t row) const {return static_cast<SHIPTYPE>(m_types[row]);}
+    STATE state(size_t row) const {return static_cast<STATE>(m_states[row]);}
+    //ships matching the type and state, each a value or ANY
+    size_t count(int type, int state) const;
+    //appends the matching IDs in ID order, returns how many were added
+    size_t select(int type, int state, vector<int>& out) const;
+    //sets bit i % 64 of bits[i / 64] for every matching row i, clears the
+    //rest; returns the number of matches
+    size_t mask(int type, int state, vector<uint64_t>& bits) const;
+    //true while the scans use the AVX2 kernels. vectorize(false) switches
+    //every scan to the scalar kernels, vectorize(true) back to AVX2 where
+    //the CPU supports it; not to be called while scans run.
+    static bool vectorized();
+    static void vectorize(bool on);
+    private:
+    FleetColumns(const FleetColumns&);
+    FleetColumns& operator=(const FleetColumns&);
+    vector<int> m_ids;
+    vector<unsigned char> m_types;  // padded to whole 64-row words with
+    vector<unsigned char> m_states; // bytes no filter matches
+    size_t m_size;
+};
+#endif
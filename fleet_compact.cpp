@@ -0,0 +1,204 @@
+#include "fleet_compact.h"
+#include <algorithm>
+
+// AVL heights stay below 64 for any fleet that fits the ID range
+static const int MAX_DEPTH = 64;
+
+// Empty fleet
+CompactFleet::CompactFleet() {
+    m_root = NIL;
+    m_free = NIL;
+    m_count = 0;
+}
+
+// Drops every node and the array storage
+void CompactFleet::clear() {
+    vector<Key>().swap(m_keys);
+    vector<uint8_t>().swap(m_height);
+    vector<uint8_t>().swap(m_types);
+    vector<uint8_t>().swap(m_states);
+    m_root = NIL;
+    m_free = NIL;
+    m_count = 0;
+}
+
+// Takes a recycled index or appends a new node to the arrays
+uint32_t CompactFleet::allocate(const Ship& ship) {
+    Key key = {ship.getID(), NIL, NIL};
+    uint32_t node = m_free;
+    if (node != NIL) {
+        m_free = m_keys[node].left;
+        m_keys[node] = key;
+        m_height[node] = 1;
+        m_types[node] = static_cast<uint8_t>(ship.getType());
+        m_states[node] = static_cast<uint8_t>(ship.getState());
+    } else {
+        node = static_cast<uint32_t>(m_keys.size());
+        m_keys.push_back(key);
+        m_height.push_back(1);
+        m_types.push_back(static_cast<uint8_t>(ship.getType()));
+        m_states.push_back(static_cast<uint8_t>(ship.getState()));
+    }
+    m_count++;
+    return node;
+}
+
+// Chains an index onto the free list
+void CompactFleet::release(uint32_t node) {
+    m_keys[node].left = m_free;
+    m_free = node;
+    m_count--;
+}
+
+// Plain descent over the key records
+uint32_t CompactFleet::search(int id) const {
+    uint32_t node = m_root;
+    while (node != NIL) {
+        const Key& key = m_keys[node];
+        if (id == key.id) break;
+        node = (id < key.id) ? key.left : key.right;
+    }
+    return node;
+}
+
+// Checks whether an ID is stored
+bool CompactFleet::contains(int id) const {
+    return search(id) != NIL;
+}
+
+// Copies a stored ship, touching the payload only on a hit
+bool CompactFleet::find(int id, Ship& out) const {
+    uint32_t node = search(id);
+    if (node == NIL) return false;
+    out = Ship(id, static_cast<SHIPTYPE>(m_types[node]), static_cast<STATE>(m_states[node]));
+    return true;
+}
+
+// Reserved bytes of all node arrays
+size_t CompactFleet::memoryBytes() const {
+    return m_keys.capacity() * sizeof(Key) + m_height.capacity() + m_types.capacity() + m_states.capacity();
+}
+
+// Recomputes a node's height from its children
+void CompactFleet::updateHeight(uint32_t node) {
+    m_height[node] = static_cast<uint8_t>(std::max(height(m_keys[node].left), height(m_keys[node].right)) + 1);
+}
+
+// Performs a left rotation
+uint32_t CompactFleet::leftRotate(uint32_t node) {
+    uint32_t A = m_keys[node].right;
+    m_keys[node].right = m_keys[A].left;
+    m_keys[A].left = node;
+    updateHeight(node);
+    updateHeight(A);
+    return A;
+}
+
+// Performs a right rotation
+uint32_t CompactFleet::rightRotate(uint32_t node) {
+    uint32_t A = m_keys[node].left;
+    m_keys[node].left = m_keys[A].right;
+    m_keys[A].right = node;
+    updateHeight(node);
+    updateHeight(A);
+    return A;
+}
+
+// Restores the AVL condition at one node
+uint32_t CompactFleet::rebalance(uint32_t node) {
+    int balance = height(m_keys[node].left) - height(m_keys[node].right);
+    if (balance > 1) {
+        uint32_t left = m_keys[node].left;
+        if (height(m_keys[left].left) < height(m_keys[left].right)) m_keys[node].left = leftRotate(left);
+        return rightRotate(node);
+    }
+    if (balance < -1) {
+        uint32_t right = m_keys[node].right;
+        if (height(m_keys[right].right) < height(m_keys[right].left)) m_keys[node].right = rightRotate(right);
+        return leftRotate(node);
+    }
+    return node;
+}
+
+// Points the parent's link (or the root) at a replacement child
+void CompactFleet::relink(uint32_t parent, uint32_t from, uint32_t to) {
+    if (parent == NIL) m_root = to;
+    else if (m_keys[parent].left == from) m_keys[parent].left = to;
+    else m_keys[parent].right = to;
+}
+
+// Single-descent AVL insert; the node is only allocated once the slot is free
+bool CompactFleet::insert(const Ship& ship) {
+    int id = ship.getID();
+    if (id < MINID || id > MAXID) return false;
+    uint32_t path[MAX_DEPTH];
+    int depth = 0;
+    uint32_t node = m_root;
+    while (node != NIL) {
+        if (id == m_keys[node].id) return false;
+        path[depth++] = node;
+        node = (id < m_keys[node].id) ? m_keys[node].left : m_keys[node].right;
+    }
+    node = allocate(ship);
+    if (depth == 0) {
+        m_root = node;
+        return true;
+    }
+    uint32_t parent = path[depth - 1];
+    if (id < m_keys[parent].id) m_keys[parent].left = node;
+    else m_keys[parent].right = node;
+
+    for (int i = depth - 1; i >= 0; i--) {
+        uint32_t current = path[i];
+        int before = m_height[current];
+        updateHeight(current);
+        uint32_t top = rebalance(current);
+        if (top != current) relink(i ? path[i - 1] : NIL, current, top);
+        if (m_height[top] == before) break;
+    }
+    return true;
+}
+
+// AVL remove; a node with two children is replaced by its successor
+bool CompactFleet::remove(int id) {
+    uint32_t path[MAX_DEPTH];
+    int depth = 0;
+    uint32_t node = m_root;
+    while (node != NIL && m_keys[node].id != id) {
+        path[depth++] = node;
+        node = (id < m_keys[node].id) ? m_keys[node].left : m_keys[node].right;
+    }
+    if (node == NIL) return false;
+    uint32_t parent = depth ? path[depth - 1] : NIL;
+    Key& key = m_keys[node];
+    if (key.left == NIL || key.right == NIL) {
+        relink(parent, node, key.left == NIL ? key.right : key.left);
+    } else {
+        int nodeDepth = depth;
+        path[depth++] = node; // Replaced by the successor below
+        uint32_t succParent = node;
+        uint32_t succ = key.right;
+        while (m_keys[succ].left != NIL) {
+            path[depth++] = succ;
+            succParent = succ;
+            succ = m_keys[succ].left;
+        }
+        relink(succParent, succ, m_keys[succ].right);
+        m_keys[succ].left = key.left;
+        m_keys[succ].right = key.right;
+        m_height[succ] = m_height[node];
+        relink(parent, node, succ);
+        path[nodeDepth] = succ;
+    }
+    release(node);
+
+    for (int i = depth - 1; i >= 0; i--) {
+        uint32_t current = path[i];
+        int before = m_height[current];
+        updateHeight(current);
+        uint32_t top = rebalance(current);
+        if (top != current) relink(i ? path[i - 1] : NIL, current, top);
+        if (m_height[top] == before) break;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef FLEET_COMPACT_H
+#define FLEET_COMPACT_H
+#include "fleet.h"
+
+// AVL fleet stored in contiguous arrays instead of individually allocated
+// Ship nodes. Nodes are addressed by 32-bit indices, and the fields a
+// descent reads (ID and child indices) are kept apart from the height and
+// the cold type/state payload, one byte each. A node costs 15 bytes, a
+// fraction of a Ship with its links, subtree counts and reference count,
+// and a lookup only walks the 12-byte key records.
+class CompactFleet{
+    public:
+    friend class Tester;
+    static const uint32_t NIL = 0xffffffffu;   // empty child index
+    CompactFleet();
+    void clear();
+    size_t size() const {return m_count;}
+    bool insert(const Ship& ship);      // false if invalid or present
+    bool remove(int id);                // false if absent
+    bool contains(int id) const;
+    bool find(int id, Ship& out) const; // copies ID, type and state
+    size_t memoryBytes() const;         // bytes reserved by the node arrays
+    private:
+    struct Key{
+        int32_t id;
+        uint32_t left, right;
+    };
+    vector<Key> m_keys;             // hot: read by every descent
+    vector<uint8_t> m_height;       // subtree height + 1, 0 for an empty child
+    vector<uint8_t> m_types;        // cold payload
+    vector<uint8_t> m_states;
+    uint32_t m_root;
+    uint32_t m_free;                // recycled indices, chained through left
+    size_t m_count;
+
+    uint32_t allocate(const Ship& ship);
+    void release(uint32_t node);
+    uint32_t search(int id) const;
+    int height(uint32_t node) const {return node == NIL ? 0 : m_height[node];}
+    void updateHeight(uint32_t node);
+    uint32_t leftRotate(uint32_t node);
+    uint32_t rightRotate(uint32_t node);
+    uint32_t rebalance(uint32_t node);
+    void relink(uint32_t parent, uint32_t from, uint32_t to);
+};
+#endif
@@ -0,0 +1,264 @@
+#include "fleet_concurrent.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+// AVL heights stay below 64 for any fleet that fits the ID range
+static const int MAX_DEPTH = 64;
+
+// Empty fleet; epoch 0 marks a free reader slot, so epochs start at 1
+ConcurrentFleet::ConcurrentFleet() {
+    m_root.store(nullptr);
+    m_count.store(0);
+    m_epoch.store(1);
+    for (int i = 0; i < READER_SLOTS; i++) m_slots[i].epoch.store(0);
+    m_overflow.store(0);
+    m_write = 0;
+}
+
+// Frees the live tree and everything still waiting for reclamation;
+// no reader may be active at this point
+ConcurrentFleet::~ConcurrentFleet() {
+    vector<const Node*> pending;
+    if (m_root.load()) pending.push_back(m_root.load());
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        if (node->left) pending.push_back(node->left);
+        if (node->right) pending.push_back(node->right);
+        delete node;
+    }
+    for (size_t i = 0; i < m_retired.size(); i++)
+        for (size_t j = 0; j < m_retired[i].nodes.size(); j++) delete m_retired[i].nodes[j];
+}
+
+// Claims a reader slot and announces the current epoch in it. Threads
+// start probing at the slot they used last, so a slot normally stays on
+// one core's cache. After one pass over taken slots the reader joins the
+// overflow slot; like an announcement, the count is raised before the root
+// is loaded, so reclaim() sees every overflow reader that could hold a node.
+int ConcurrentFleet::enter() const {
+    static thread_local int hint = -1;
+    if (hint < 0) hint = static_cast<int>(std::hash<std::thread::id>()(std::this_thread::get_id()) % READER_SLOTS);
+    for (int probe = 0, i = hint; probe < READER_SLOTS; probe++, i = (i + 1) % READER_SLOTS) {
+        unsigned long expected = 0;
+        if (m_slots[i].epoch.load(std::memory_order_relaxed) == 0 &&
+            m_slots[i].epoch.compare_exchange_strong(expected, m_epoch.load())) {
+            hint = i;
+            return i;
+        }
+    }
+    m_overflow.fetch_add(1);
+    return OVERFLOW_SLOT;
+}
+
+// Frees the slot taken by enter()
+void ConcurrentFleet::leave(int slot) const {
+    if (slot == OVERFLOW_SLOT) m_overflow.fetch_sub(1);
+    else m_slots[slot].epoch.store(0);
+}
+
+// Plain descent from the current root; the caller holds a reader slot
+const ConcurrentFleet::Node* ConcurrentFleet::search(int id) const {
+    const Node* node = m_root.load();
+    while (node && node->id != id) node = (id < node->id) ? node->left : node->right;
+    return node;
+}
+
+// Checks whether an ID is stored, without taking any lock
+bool ConcurrentFleet::contains(int id) const {
+    int slot = enter();
+    bool found = search(id) != nullptr;
+    leave(slot);
+    return found;
+}
+
+// Copies a stored ship, without taking any lock
+bool ConcurrentFleet::find(int id, Ship& out) const {
+    int slot = enter();
+    const Node* node = search(id);
+    if (node) out = Ship(id, static_cast<SHIPTYPE>(node->type), static_cast<STATE>(node->state));
+    leave(slot);
+    return node != nullptr;
+}
+
+// New node owned by the current write
+ConcurrentFleet::Node* ConcurrentFleet::create(int id, unsigned char type, unsigned char state) {
+    Node* node = new Node;
+    node->id = id;
+    node->type = type;
+    node->state = state;
+    node->height = 0;
+    node->left = nullptr;
+    node->right = nullptr;
+    node->born = m_write;
+    return node;
+}
+
+// Returns a node the current write may change: nodes it created itself are
+// still private, published ones are copied and queued for reclamation
+ConcurrentFleet::Node* ConcurrentFleet::writable(const Node* node) {
+    if (node->born == m_write) return const_cast<Node*>(node);
+    Node* copy = create(node->id, node->type, node->state);
+    copy->height = node->height;
+    copy->left = node->left;
+    copy->right = node->right;
+    m_unlinked.push_back(node);
+    return copy;
+}
+
+// Updates a node's height based on its children's heights
+void ConcurrentFleet::updateHeight(Node* node) {
+    node->height = std::max(height(node->left), height(node->right)) + 1;
+}
+
+// Performs a left rotation on a writable node
+ConcurrentFleet::Node* ConcurrentFleet::leftRotate(Node* node) {
+    Node* A = writable(node->right);
+    node->right = A->left;
+    A->left = node;
+    updateHeight(node);
+    updateHeight(A);
+    return A;
+}
+
+// Performs a right rotation on a writable node
+ConcurrentFleet::Node* ConcurrentFleet::rightRotate(Node* node) {
+    Node* A = writable(node->left);
+    node->left = A->right;
+    A->right = node;
+    updateHeight(node);
+    updateHeight(A);
+    return A;
+}
+
+// Restores the AVL condition at a writable node
+ConcurrentFleet::Node* ConcurrentFleet::rebalance(Node* node) {
+    int balance = height(node->left) - height(node->right);
+    if (balance > 1) {
+        if (height(node->left->left) < height(node->left->right)) node->left = leftRotate(writable(node->left));
+        return rightRotate(node);
+    }
+    if (balance < -1) {
+        if (height(node->right->right) < height(node->right->left)) node->right = rightRotate(writable(node->right));
+        return leftRotate(node);
+    }
+    return node;
+}
+
+// Swaps in the new root, retires the replaced nodes under the current
+// epoch and opens the next one. A reader that announces the new epoch has
+// necessarily loaded the new root, so it can never reach a retired node.
+void ConcurrentFleet::publish(const Node* root) {
+    m_root.store(root);
+    if (!m_unlinked.empty()) {
+        Retired retired;
+        retired.epoch = m_epoch.load();
+        retired.nodes.swap(m_unlinked);
+        m_retired.push_back(retired);
+    }
+    m_epoch.fetch_add(1);
+    reclaim();
+}
+
+// Frees every retired batch older than the oldest epoch a reader announced.
+// Overflow readers announce no epoch, so nothing is freed while any is active.
+void ConcurrentFleet::reclaim() {
+    if (m_retired.empty() || m_overflow.load()) return;
+    unsigned long oldest = m_epoch.load();
+    for (int i = 0; i < READER_SLOTS; i++) {
+        unsigned long epoch = m_slots[i].epoch.load();
+        if (epoch && epoch < oldest) oldest = epoch;
+    }
+    size_t done = 0;
+    while (done < m_retired.size() && m_retired[done].epoch < oldest) {
+        for (size_t j = 0; j < m_retired[done].nodes.size(); j++) delete m_retired[done].nodes[j];
+        done++;
+    }
+    m_retired.erase(m_retired.begin(), m_retired.begin() + done);
+}
+
+// Path-copying AVL insert: the search path is copied bottom-up with the
+// new leaf linked in, rebalancing each copy on the way to the new root
+bool ConcurrentFleet::insert(const Ship& ship) {
+    int id = ship.getID();
+    if (id < MINID || id > MAXID) return false;
+    std::lock_guard<std::mutex> lock(m_writer);
+    m_write++;
+    const Node* path[MAX_DEPTH];
+    bool wentRight[MAX_DEPTH];
+    int depth = 0;
+    const Node* node = m_root.load();
+    while (node) {
+        if (id == node->id) return false;
+        path[depth] = node;
+        wentRight[depth] = id > node->id;
+        node = wentRight[depth++] ? node->right : node->left;
+    }
+    const Node* child = create(id, static_cast<unsigned char>(ship.getType()), static_cast<unsigned char>(ship.getState()));
+    for (int i = depth - 1; i >= 0; i--) {
+        Node* copy = writable(path[i]);
+        if (wentRight[i]) copy->right = child;
+        else copy->left = child;
+        updateHeight(copy);
+        child = rebalance(copy);
+    }
+    publish(child);
+    m_count.fetch_add(1);
+    return true;
+}
+
+// Path-copying AVL remove. A node with two children is replaced by a copy
+// of its in-order successor, and the path down to the successor is copied
+// with the successor unlinked.
+bool ConcurrentFleet::remove(int id) {
+    std::lock_guard<std::mutex> lock(m_writer);
+    m_write++;
+    const Node* path[MAX_DEPTH];
+    bool wentRight[MAX_DEPTH];
+    int depth = 0;
+    const Node* node = m_root.load();
+    while (node && node->id != id) {
+        path[depth] = node;
+        wentRight[depth] = id > node->id;
+        node = wentRight[depth++] ? node->right : node->left;
+    }
+    if (!node) return false;
+    m_unlinked.push_back(node);
+
+    const Node* child;
+    const Node* succ = nullptr;
+    int nodeDepth = -1;
+    if (node->left && node->right) {
+        nodeDepth = depth;
+        path[depth] = node;
+        wentRight[depth++] = true;
+        succ = node->right;
+        while (succ->left) {
+            path[depth] = succ;
+            wentRight[depth++] = false;
+            succ = succ->left;
+        }
+        m_unlinked.push_back(succ);
+        child = succ->right;
+    } else {
+        child = node->left ? node->left : node->right;
+    }
+    for (int i = depth - 1; i >= 0; i--) {
+        Node* copy;
+        if (i == nodeDepth) {
+            // The successor takes the removed node's place
+            copy = create(succ->id, succ->type, succ->state);
+            copy->left = node->left;
+        } else {
+            copy = writable(path[i]);
+        }
+        if (wentRight[i]) copy->right = child;
+        else copy->left = child;
+        updateHeight(copy);
+        child = rebalance(copy);
+    }
+    publish(child);
+    m_count.fetch_sub(1);
+    return true;
+}
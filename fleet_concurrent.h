@@ -0,0 +1,78 @@
+#ifndef FLEET_CONCURRENT_H
+#define FLEET_CONCURRENT_H
+#include "fleet.h"
+#include <atomic>
+#include <mutex>
+
+// AVL fleet for many query threads. Published nodes are never modified:
+// a writer copies the nodes on its root-to-leaf path (and any node a
+// rotation touches), links the copies into a new tree that shares every
+// other node, and swaps the root pointer atomically. Lookups therefore
+// take no lock and never wait for a writer; writers serialize on a mutex.
+//
+// Replaced nodes are reclaimed with epochs: a reader announces the global
+// epoch in a slot while it walks the tree, and nodes retired in epoch E are
+// only freed once no announced epoch is E or older. Readers beyond the
+// READER_SLOTS slots never wait: they are counted in an overflow slot
+// instead, which holds back all reclamation until it empties.
+class ConcurrentFleet{
+    public:
+    friend class Tester;
+    ConcurrentFleet();
+    ~ConcurrentFleet();
+    bool insert(const Ship& ship);      // false if invalid or present
+    bool remove(int id);                // false if absent
+    bool contains(int id) const;
+    bool find(int id, Ship& out) const; // copies ID, type and state
+    size_t size() const {return m_count.load();}
+    private:
+    struct Node{
+        int id;
+        unsigned char type, state;
+        int height;
+        const Node* left;
+        const Node* right;
+        unsigned long born;     // write that created the node
+    };
+    struct Retired{
+        unsigned long epoch;    // epoch the nodes were unlinked in
+        vector<const Node*> nodes;
+    };
+    // One cache line per slot so readers do not share lines
+    struct Slot{
+        std::atomic<unsigned long> epoch;   // 0 while the slot is free
+        char pad[64 - sizeof(std::atomic<unsigned long>)];
+    };
+    static const int READER_SLOTS = 64;
+    static const int OVERFLOW_SLOT = READER_SLOTS;  // returned by enter() when every slot is taken
+
+    ConcurrentFleet(const ConcurrentFleet&);
+    ConcurrentFleet& operator=(const ConcurrentFleet&);
+
+    std::atomic<const Node*> m_root;
+    std::atomic<size_t> m_count;
+    std::atomic<unsigned long> m_epoch;
+    mutable Slot m_slots[READER_SLOTS];
+    mutable std::atomic<int> m_overflow;   // readers in the overflow slot
+    std::mutex m_writer;            // serializes insert/remove
+    unsigned long m_write;          // sequence number of the current write
+    vector<const Node*> m_unlinked; // nodes replaced by the current write
+    vector<Retired> m_retired;      // waiting for readers to move on
+
+    // reader side
+    int enter() const;
+    void leave(int slot) const;
+    const Node* search(int id) const;
+
+    // writer side, called with m_writer held
+    Node* create(int id, unsigned char type, unsigned char state);
+    Node* writable(const Node* node);
+    static int height(const Node* node) {return node ? node->height : -1;}
+    static void updateHeight(Node* node);
+    Node* leftRotate(Node* node);
+    Node* rightRotate(Node* node);
+    Node* rebalance(Node* node);
+    void publish(const Node* root);
+    void reclaim();
+};
+#endif
@@ -0,0 +1,138 @@
+#include "fleet_file.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char FLEET_MAGIC[8] = "SHIPFLT";
+
+// Byte-at-a-time FNV-1a
+uint64_t fleetChecksum(const void* data, size_t length, uint64_t hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// The directory is the part of path before its last slash, "." if none
+bool fleetSyncDirectory(const char* path) {
+    std::string dir(path);
+    size_t slash = dir.rfind('/');
+    dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : dir.substr(0, slash));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+// Nothing mapped yet
+MappedFleet::MappedFleet() {
+    m_map = nullptr;
+    m_length = 0;
+    m_ids = nullptr;
+    m_payload = nullptr;
+    m_count = 0;
+    m_checksum = 0;
+}
+
+// Unmaps the file
+MappedFleet::~MappedFleet() {
+    close();
+}
+
+// Maps the whole file read-only and validates it before exposing records
+bool MappedFleet::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(FleetFileHeader))
+        map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (map == MAP_FAILED) return false;
+    m_map = map;
+    m_length = info.st_size;
+
+    const FleetFileHeader* header = static_cast<const FleetFileHeader*>(map);
+    const char* base = static_cast<const char*>(map);
+    bool valid = memcmp(header->magic, FLEET_MAGIC, sizeof(FLEET_MAGIC)) == 0 &&
+                 header->version == FLEET_FILE_VERSION &&
+                 header->headerSize == sizeof(FleetFileHeader) &&
+                 header->count <= size_t(DenseTable::SLOTS) &&
+                 m_length == header->headerSize + header->count * (sizeof(int32_t) + 1);
+    if (valid) {
+        m_count = header->count;
+        m_ids = reinterpret_cast<const int32_t*>(base + header->headerSize);
+        m_payload = reinterpret_cast<const uint8_t*>(m_ids + m_count);
+        m_checksum = header->checksum;
+        valid = fleetChecksum(m_ids, m_length - header->headerSize) == m_checksum;
+    }
+    for (size_t i = 0; valid && i < m_count; i++) {
+        int low = i ? m_ids[i - 1] + 1 : MINID;
+        valid = m_ids[i] >= low && m_ids[i] <= MAXID && (m_payload[i] & 7) < SHIPTYPES && (m_payload[i] >> 3) <= LOST;
+    }
+    if (!valid) close();
+    return valid;
+}
+
+// Drops the mapping
+void MappedFleet::close() {
+    if (m_map) munmap(m_map, m_length);
+    m_map = nullptr;
+    m_length = 0;
+    m_ids = nullptr;
+    m_payload = nullptr;
+    m_count = 0;
+    m_checksum = 0;
+}
+
+// Branchless binary search for the last ID <= id
+size_t MappedFleet::search(int id) const {
+    if (!m_count) return 0;
+    const int32_t* base = m_ids;
+    for (size_t n = m_count; n > 1; n -= n / 2)
+        base = (base[n / 2] <= id) ? base + n / 2 : base;
+    return (*base == id) ? size_t(base - m_ids) : m_count;
+}
+
+// Copies a stored ship
+bool MappedFleet::find(int id, Ship& out) const {
+    size_t i = search(id);
+    if (i == m_count) return false;
+    out = Ship(id, static_cast<SHIPTYPE>(m_payload[i] & 7), static_cast<STATE>(m_payload[i] >> 3));
+    return true;
+}
+
+// Writes header and both columns and syncs them, then publishes the file
+// with a rename. Without the sync a crash after the rename could leave an
+// empty or partial file in place of the old one.
+bool MappedFleet::write(const char* path, const int32_t* ids, const uint8_t* payload, size_t n) {
+    FleetFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLEET_MAGIC, sizeof(FLEET_MAGIC));
+    header.version = FLEET_FILE_VERSION;
+    header.headerSize = sizeof(FleetFileHeader);
+    header.count = n;
+    header.checksum = fleetChecksum(payload, n, fleetChecksum(ids, n * sizeof(int32_t)));
+
+    std::string temp = std::string(path) + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) return false;
+    // An empty fleet may pass null columns, which fwrite must not see
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   (n == 0 || (fwrite(ids, sizeof(int32_t), n, file) == n && fwrite(payload, 1, n, file) == n)) &&
+                   fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = (fclose(file) == 0) && written;
+    if (!written || std::rename(temp.c_str(), path) != 0) {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return fleetSyncDirectory(path);
+}
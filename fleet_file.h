@@ -0,0 +1,59 @@
+#ifndef FLEET_FILE_H
+#define FLEET_FILE_H
+#include "fleet.h"
+
+// Fleet image written by Fleet::save(), in host (little-endian) byte order:
+//   FleetFileHeader                    32 bytes
+//   IDs                                count x int32, strictly ascending
+//   payload                            count x uint8, packed like FleetSnapshot::pack
+// The checksum is 64-bit FNV-1a over the two record columns.
+struct FleetFileHeader{
+    char magic[8];          // "SHIPFLT" and a terminating zero
+    uint32_t version;       // FLEET_FILE_VERSION
+    uint32_t headerSize;    // sizeof(FleetFileHeader), records start here
+    uint64_t count;         // number of ships
+    uint64_t checksum;      // FNV-1a of the IDs and payload columns
+};
+const uint32_t FLEET_FILE_VERSION = 1;
+
+// 64-bit FNV-1a of a byte range, continued from 'hash'; used for the fleet
+// file and the journal checksums
+uint64_t fleetChecksum(const void* data, size_t length, uint64_t hash = 14695981039346656037ULL);
+
+// fsyncs the directory holding path, so a rename onto path survives a
+// crash; used after every rename that publishes a fleet or journal file
+bool fleetSyncDirectory(const char* path);
+
+// Read-only fleet served straight from a memory-mapped fleet file. open()
+// checks the header, checksum and ID order once; after that lookups binary
+// search the mapped ID column and read the payload byte only on a hit, so
+// no node is ever built. Fleet::load() uses it to read files too.
+class MappedFleet{
+    public:
+    MappedFleet();
+    ~MappedFleet();
+    bool open(const char* path);    // false if missing, truncated or corrupt
+    void close();
+    bool isOpen() const {return m_map != nullptr;}
+    size_t size() const {return m_count;}
+    bool contains(int id) const {return search(id) != m_count;}
+    bool find(int id, Ship& out) const; // copies ID, type and state
+    uint64_t checksum() const {return m_checksum;}
+    const int32_t* ids() const {return m_ids;}
+    const uint8_t* payload() const {return m_payload;}
+    //writes n records sorted by ID to a temporary file, fsyncs it, renames
+    //it over path and fsyncs the directory: readers never see a half-written
+    //file, and once write() returns the new file survives a crash
+    static bool write(const char* path, const int32_t* ids, const uint8_t* payload, size_t n);
+    private:
+    MappedFleet(const MappedFleet&);
+    MappedFleet& operator=(const MappedFleet&);
+    size_t search(int id) const;    // index of id, m_count if absent
+    void* m_map;                // whole file mapping
+    size_t m_length;            // bytes mapped
+    const int32_t* m_ids;       // ID column inside the mapping
+    const uint8_t* m_payload;   // payload column inside the mapping
+    size_t m_count;
+    uint64_t m_checksum;        // from the validated header
+};
+#endif
@@ -0,0 +1,233 @@
+#include "fleet_journal.h"
+#include "fleet_file.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Journal file layout, host byte order:
+//   JournalHeader                      24 bytes
+//   groups                             GroupHeader then count x Record
+// A group whose records are cut short or fail the checksum ends the journal.
+static const char JOURNAL_MAGIC[8] = "SHIPJRN";
+static const uint32_t JOURNAL_VERSION = 1;
+
+struct JournalHeader{
+    char magic[8];          // "SHIPJRN" and a terminating zero
+    uint32_t version;       // JOURNAL_VERSION
+    uint32_t headerSize;    // sizeof(JournalHeader), groups start here
+    uint64_t base;          // checksum of the snapshot the records apply to, 0 for none
+};
+
+struct GroupHeader{
+    uint32_t count;         // records in the group
+    uint32_t checksum;      // low half of the FNV-1a of count and records
+};
+
+// Checksum of a group, covering its record count as well; bytes is the
+// size of the count records
+static uint32_t groupChecksum(uint32_t count, const void* records, size_t bytes) {
+    uint64_t hash = fleetChecksum(&count, sizeof(count));
+    return static_cast<uint32_t>(fleetChecksum(records, bytes, hash));
+}
+
+// Writes the whole buffer, retrying short writes
+static bool writeAll(int fd, const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length) {
+        ssize_t done = ::write(fd, bytes, length);
+        if (done <= 0) return false;
+        bytes += done;
+        length -= done;
+    }
+    return true;
+}
+
+// Reads exactly length bytes, false at end of file
+static bool readAll(int fd, void* data, size_t length) {
+    char* bytes = static_cast<char*>(data);
+    while (length) {
+        ssize_t done = ::read(fd, bytes, length);
+        if (done <= 0) return false;
+        bytes += done;
+        length -= done;
+    }
+    return true;
+}
+
+// Not attached to any fleet or file yet
+FleetJournal::FleetJournal(size_t groupSize) {
+    m_fleet = nullptr;
+    m_fd = -1;
+    m_groupSize = groupSize ? groupSize : 1;
+    m_replayed = 0;
+    m_failed = false;
+}
+
+// Flushes the last group
+FleetJournal::~FleetJournal() {
+    close();
+}
+
+// Path compact() stages the next snapshot at
+static std::string stagedPath(const char* snapshotPath) {
+    return std::string(snapshotPath) + ".next";
+}
+
+// Checksum of a valid fleet file, 0 if it is missing or corrupt
+static uint64_t snapshotChecksum(const char* path) {
+    MappedFleet snapshot;
+    return snapshot.open(path) ? snapshot.checksum() : 0;
+}
+
+// Restores the fleet from the snapshot and the journal's complete groups,
+// cuts off a torn tail and attaches to the fleet for new records
+bool FleetJournal::recover(Fleet& fleet, const char* snapshotPath, const char* journalPath) {
+    close();
+    m_path = journalPath;
+    m_failed = false;
+    m_replayed = 0;
+    TREETYPE type = (fleet.getType() == NONE) ? AVL : fleet.getType();
+    fleet.attachJournal(nullptr);
+
+    int fd = ::open(journalPath, O_RDWR);
+    JournalHeader header;
+    bool parsed = fd >= 0 && readAll(fd, &header, sizeof(header)) &&
+                  memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+                  header.version == JOURNAL_VERSION && header.headerSize == sizeof(header);
+    uint64_t base = snapshotChecksum(snapshotPath);
+    if (parsed && header.base != base) {
+        // A compaction that crashed after restarting the journal left its
+        // snapshot staged; anything else means the records' base is gone
+        std::string staged = stagedPath(snapshotPath);
+        if (header.base == 0 || snapshotChecksum(staged.c_str()) != header.base ||
+            std::rename(staged.c_str(), snapshotPath) != 0 || !fleetSyncDirectory(snapshotPath)) {
+            ::close(fd);
+            return false;
+        }
+        base = header.base;
+    }
+    if (base) {
+        fleet.setType(type);
+        if (!fleet.load(snapshotPath)) {
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+    } else {
+        fleet.clear();
+        fleet.setType(type);
+    }
+    if (!parsed) {
+        // Missing or damaged header: nothing in the file can be replayed
+        if (fd >= 0) ::close(fd);
+        if (!startFile(base)) return false;
+        fleet.attachJournal(this);
+        m_fleet = &fleet;
+        return true;
+    }
+    struct stat info;
+    off_t length = (fstat(fd, &info) == 0) ? info.st_size : 0;
+    off_t end = sizeof(header);
+    GroupHeader group;
+    vector<Record> records;
+    vector<FleetUpdate> updates;
+    while (readAll(fd, &group, sizeof(group))) {
+        off_t next = end + off_t(sizeof(group) + uint64_t(group.count) * sizeof(Record));
+        if (group.count == 0 || next > length) break; // Torn tail
+        records.resize(group.count);
+        if (!readAll(fd, records.data(), group.count * sizeof(Record)) ||
+            groupChecksum(group.count, records.data(), group.count * sizeof(Record)) != group.checksum)
+            break; // Torn tail
+        updates.resize(group.count);
+        for (size_t i = 0; i < group.count; i++) {
+            updates[i].op = static_cast<UPDATEOP>(records[i].op);
+            updates[i].ship = Ship(records[i].id, static_cast<SHIPTYPE>(records[i].payload & 7),
+                                   static_cast<STATE>(records[i].payload >> 3));
+        }
+        fleet.applyUpdates(updates);
+        m_replayed += group.count;
+        end = next;
+    }
+    if (ftruncate(fd, end) != 0 || lseek(fd, end, SEEK_SET) != end) {
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+    fleet.attachJournal(this);
+    m_fleet = &fleet;
+    return true;
+}
+
+// Saves the fleet as a staged snapshot, swaps in an empty journal based on
+// it, then moves the snapshot into place. save() has synced the staged file
+// and its directory by the time it returns, so the new journal can never
+// reach the disk ahead of the snapshot it names.
+bool FleetJournal::compact(const char* snapshotPath) {
+    if (!m_fleet || !commit()) return false;
+    std::string staged = stagedPath(snapshotPath);
+    uint64_t base = m_fleet->save(staged.c_str()) ? snapshotChecksum(staged.c_str()) : 0;
+    if (!base || !startFile(base)) return false;
+    return std::rename(staged.c_str(), snapshotPath) == 0 && fleetSyncDirectory(snapshotPath);
+}
+
+// Buffers one record; a full group is written right away
+void FleetJournal::append(UPDATEOP op, const Ship& ship) {
+    Record record = {static_cast<uint8_t>(op), static_cast<uint8_t>(ship.getState() << 3 | ship.getType()), 0,
+                     ship.getID()};
+    m_pending.push_back(record);
+    if (m_pending.size() >= m_groupSize) commit();
+}
+
+// Writes the pending records as one group and waits for the disk. After a
+// failed write nothing more is written, since recovery stops at that group.
+bool FleetJournal::commit() {
+    if (m_pending.empty()) return !m_failed;
+    if (m_fd < 0 || m_failed) {
+        m_pending.clear();
+        return false;
+    }
+    size_t bytes = m_pending.size() * sizeof(Record);
+    GroupHeader group = {static_cast<uint32_t>(m_pending.size()), groupChecksum(uint32_t(m_pending.size()), m_pending.data(), bytes)};
+    const char* records = reinterpret_cast<const char*>(m_pending.data());
+    vector<char> buffer(reinterpret_cast<const char*>(&group), reinterpret_cast<const char*>(&group + 1));
+    buffer.insert(buffer.end(), records, records + bytes);
+    m_pending.clear();
+    m_failed = !writeAll(m_fd, buffer.data(), buffer.size()) || fdatasync(m_fd) != 0;
+    return !m_failed;
+}
+
+// Flushes, detaches from the fleet and closes the file
+void FleetJournal::close() {
+    commit();
+    if (m_fleet) m_fleet->attachJournal(nullptr);
+    m_fleet = nullptr;
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+}
+
+// Writes a header-only journal next to m_path, syncs it, renames it over
+// the old one and syncs the directory, then appends to the new file
+bool FleetJournal::startFile(uint64_t base) {
+    JournalHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.headerSize = sizeof(header);
+    header.base = base;
+
+    std::string temp = m_path + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (!writeAll(fd, &header, sizeof(header)) || fsync(fd) != 0 || std::rename(temp.c_str(), m_path.c_str()) != 0 ||
+        !fleetSyncDirectory(m_path.c_str())) {
+        ::close(fd);
+        std::remove(temp.c_str());
+        m_failed = true;
+        return false;
+    }
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = fd;
+    m_failed = false;
+    return true;
+}
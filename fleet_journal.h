@@ -0,0 +1,55 @@
+#ifndef FLEET_JOURNAL_H
+#define FLEET_JOURNAL_H
+#include "fleet.h"
+
+// Write-ahead journal of a fleet's per-ship mutations. An attached Fleet
+// appends one record per insert, remove, update, upsert or batch event;
+// records collect in memory and are written and fsynced as one checksummed
+// group once groupSize of them are pending (or on commit()), so a single
+// fsync covers the whole group. A crash loses at most the pending group.
+//
+// The journal starts with the checksum of the snapshot it builds on.
+// recover() loads that snapshot and replays the journal's complete groups
+// on top, stopping at a torn tail; compact() stages a new snapshot next to
+// the old one, restarts the journal on it and only then moves it into
+// place. If a crash hits before the journal moved on, the old pair is
+// still intact; if it hits after, recover() finishes the move. A journal
+// naming any other snapshot is never discarded: recover() fails and leaves
+// it for the caller.
+class FleetJournal{
+    public:
+    explicit FleetJournal(size_t groupSize = 64);
+    ~FleetJournal();    // commits pending records and detaches
+    //loads the snapshot if it exists and replays the matching journal into
+    //an empty fleet, then attaches to the fleet and appends to the journal.
+    //A missing or unreadable journal header starts a new journal; false if
+    //the journal names a snapshot that is missing or was replaced.
+    bool recover(Fleet& fleet, const char* snapshotPath, const char* journalPath);
+    //saves the fleet as the new snapshot and starts an empty journal on it
+    bool compact(const char* snapshotPath);
+    void append(UPDATEOP op, const Ship& ship);    // called by the fleet
+    bool commit();      // writes and fsyncs the pending group
+    void close();       // commits, detaches and closes the file
+    void setGroupSize(size_t records) {m_groupSize = records ? records : 1;}
+    size_t pending() const {return m_pending.size();}
+    size_t replayed() const {return m_replayed;}    // events of the last recover
+    bool good() const {return !m_failed;}           // false after an I/O error
+    private:
+    FleetJournal(const FleetJournal&);
+    FleetJournal& operator=(const FleetJournal&);
+    struct Record{
+        uint8_t op;         // UPDATEOP
+        uint8_t payload;    // packed type and state
+        uint16_t unused;
+        int32_t id;
+    };
+    bool startFile(uint64_t base);  // writes a fresh journal over m_path
+    Fleet* m_fleet;
+    std::string m_path;
+    int m_fd;
+    size_t m_groupSize;
+    vector<Record> m_pending;
+    size_t m_replayed;
+    bool m_failed;
+};
+#endif
@@ -0,0 +1,161 @@
+#include "fleet_sharded.h"
+#include "fleet_sink.h"
+#include <algorithm>
+
+// Starts the worker threads; the caller of run() works as well
+WorkerPool::WorkerPool(int workers) {
+    m_tasks = nullptr;
+    m_next = 0;
+    m_pending = 0;
+    m_stop = false;
+    for (int i = 0; i < workers; i++) m_threads.push_back(std::thread(&WorkerPool::work, this));
+}
+
+// Stops and joins the worker threads
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++) m_threads[i].join();
+}
+
+// Runs a batch of tasks to completion. The current batch lives in the
+// pool-wide members, so a second caller waits until the first one is done.
+void WorkerPool::run(vector<std::function<void()> >& tasks) {
+    if (tasks.empty()) return;
+    std::lock_guard<std::mutex> batch(m_batch);
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_tasks = &tasks;
+        m_next = 0;
+        m_pending = tasks.size();
+    }
+    m_wake.notify_all();
+    while (runOne()) {}
+    std::unique_lock<std::mutex> guard(m_lock);
+    while (m_pending) m_idle.wait(guard);
+    m_tasks = nullptr;
+}
+
+// Takes the next task of the current batch and runs it outside the lock
+bool WorkerPool::runOne() {
+    std::function<void()>* task;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_tasks || m_next == m_tasks->size()) return false;
+        task = &(*m_tasks)[m_next++];
+    }
+    (*task)();
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (--m_pending == 0) m_idle.notify_all();
+    return true;
+}
+
+// Worker loop: sleep until a batch has tasks left, then help run them
+void WorkerPool::work() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            while (!m_stop && (!m_tasks || m_next == m_tasks->size())) m_wake.wait(guard);
+            if (m_stop) return;
+        }
+        while (runOne()) {}
+    }
+}
+
+// Splits [MINID, MAXID] into equal contiguous ranges, one per shard
+ShardedFleet::ShardedFleet(int shards, TREETYPE type, int workers)
+    : m_workers(workers > 0 ? workers - 1 : std::max(1, int(std::thread::hardware_concurrency())) - 1) {
+    if (shards < 1) shards = 1;
+    m_width = (MAXID - MINID + shards) / shards;
+    for (int s = 0; s < shards; s++) m_shards.push_back(std::unique_ptr<Shard>(new Shard(type)));
+}
+
+// Changes the layout of one shard
+void ShardedFleet::setShardType(int shard, TREETYPE type) {
+    std::lock_guard<std::mutex> guard(m_shards[shard]->lock);
+    m_shards[shard]->fleet.setType(type);
+}
+
+// Total number of ships across the shards
+size_t ShardedFleet::size() const {
+    size_t total = 0;
+    for (size_t s = 0; s < m_shards.size(); s++) {
+        std::lock_guard<std::mutex> guard(m_shards[s]->lock);
+        total += m_shards[s]->fleet.size();
+    }
+    return total;
+}
+
+// Inserts one ship into its shard
+void ShardedFleet::insert(const Ship& ship) {
+    if (!valid(ship.getID())) return;
+    Shard& shard = *m_shards[shardOf(ship.getID())];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.fleet.insert(ship);
+}
+
+// Removes one ship from its shard
+void ShardedFleet::remove(int id) {
+    if (!valid(id)) return;
+    Shard& shard = *m_shards[shardOf(id)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.fleet.remove(id);
+}
+
+// Looks an ID up in its shard (SPLAY shards splay it)
+bool ShardedFleet::contains(int id) {
+    if (!valid(id)) return false;
+    Shard& shard = *m_shards[shardOf(id)];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.fleet.contains(id);
+}
+
+// Groups the batch by shard, keeping each shard's ships in batch order,
+// and hands every group to its shard's insertMany as one pool task
+void ShardedFleet::insertMany(const Ship* ships, size_t n) {
+    vector<vector<Ship> > groups(m_shards.size());
+    for (size_t i = 0; i < n; i++)
+        if (valid(ships[i].getID())) groups[shardOf(ships[i].getID())].push_back(ships[i]);
+    vector<std::function<void()> > tasks;
+    for (size_t s = 0; s < groups.size(); s++) {
+        if (groups[s].empty()) continue;
+        Shard* shard = m_shards[s].get();
+        const vector<Ship>* group = &groups[s];
+        tasks.push_back([shard, group]() {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            shard->fleet.insertMany(group->data(), group->size());
+        });
+    }
+    m_workers.run(tasks);
+}
+
+// Groups the IDs by shard and removes every group with removeMany
+void ShardedFleet::removeMany(const int* ids, size_t n) {
+    vector<vector<int> > groups(m_shards.size());
+    for (size_t i = 0; i < n; i++)
+        if (valid(ids[i])) groups[shardOf(ids[i])].push_back(ids[i]);
+    vector<std::function<void()> > tasks;
+    for (size_t s = 0; s < groups.size(); s++) {
+        if (groups[s].empty()) continue;
+        Shard* shard = m_shards[s].get();
+        const vector<int>* group = &groups[s];
+        tasks.push_back([shard, group]() {
+            std::lock_guard<std::mutex> guard(shard->lock);
+            shard->fleet.removeMany(group->data(), group->size());
+        });
+    }
+    m_workers.run(tasks);
+}
+
+// Dumps the shards one after another, which is ID order, through one
+// buffered sink
+void ShardedFleet::dumpTree() const {
+    OstreamSink sink(cout);
+    for (size_t s = 0; s < m_shards.size(); s++) {
+        std::lock_guard<std::mutex> guard(m_shards[s]->lock);
+        m_shards[s]->fleet.dumpTree(sink);
+    }
+}
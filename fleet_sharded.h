@@ -0,0 +1,79 @@
+#ifndef FLEET_SHARDED_H
+#define FLEET_SHARDED_H
+#include "fleet.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed set of worker threads for fork-join batches: run() hands out the
+// tasks, helps execute them on the calling thread and returns once all of
+// them have finished. Batches from several threads take turns.
+class WorkerPool{
+    public:
+    explicit WorkerPool(int workers);
+    ~WorkerPool();
+    void run(vector<std::function<void()> >& tasks);
+    private:
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+    void work();
+    bool runOne();  // runs one task of the current batch, false when none left
+    vector<std::thread> m_threads;
+    std::mutex m_batch;     // held by run() for its whole batch
+    std::mutex m_lock;
+    std::condition_variable m_wake;     // a batch arrived or the pool stops
+    std::condition_variable m_idle;     // the last task of a batch finished
+    vector<std::function<void()> >* m_tasks;
+    size_t m_next;      // next task to hand out
+    size_t m_pending;   // tasks not finished yet
+    bool m_stop;
+};
+
+// Fleet split into independent shards by contiguous ID ranges, each with
+// its own lock and its own TREETYPE. Single operations lock one shard;
+// batches are grouped by shard and applied in parallel on a worker pool.
+// Because shards own ascending ID ranges, ordered walks simply visit the
+// shards in order.
+class ShardedFleet{
+    public:
+    ShardedFleet(int shards, TREETYPE type = AVL, int workers = 0); // 0: one per core
+    int shardCount() const {return int(m_shards.size());}
+    int shardOf(int id) const {return (id - MINID) / m_width;}
+    void setShardType(int shard, TREETYPE type);
+    size_t size() const;
+    void insert(const Ship& ship);
+    void remove(int id);
+    bool contains(int id);
+    void insertMany(const Ship* ships, size_t n);
+    void removeMany(const int* ids, size_t n);
+    void dumpTree() const;  // the shards' dumps in ID order
+    //calls fn(const Ship&) in ID order for lo <= ID <= hi; each shard is
+    //locked while its part of the range is visited
+    template <class Fn>
+    void forEachInRange(int lo, int hi, Fn fn) const;
+    private:
+    struct Shard{
+        Shard(TREETYPE type) : fleet(type) {}
+        Fleet fleet;
+        mutable std::mutex lock;
+    };
+    ShardedFleet(const ShardedFleet&);
+    ShardedFleet& operator=(const ShardedFleet&);
+    bool valid(int id) const {return id >= MINID && id <= MAXID;}
+    vector<std::unique_ptr<Shard> > m_shards;
+    int m_width;            // IDs per shard
+    WorkerPool m_workers;
+};
+
+template <class Fn>
+void ShardedFleet::forEachInRange(int lo, int hi, Fn fn) const {
+    if (lo < MINID) lo = MINID;
+    if (hi > MAXID) hi = MAXID;
+    if (lo > hi) return;
+    for (int s = shardOf(lo); s <= shardOf(hi); s++) {
+        std::lock_guard<std::mutex> guard(m_shards[s]->lock);
+        m_shards[s]->fleet.forEachInRange(lo, hi, fn);
+    }
+}
+#endif
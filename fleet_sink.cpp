@@ -0,0 +1,28 @@
+#include "fleet_sink.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+// Copies text into the buffer, flushing whenever it fills up
+void FleetSink::put(std::string_view text) {
+    while (!text.empty()) {
+        if (m_used == CHUNK) flush();
+        size_t length = std::min(text.size(), CHUNK - m_used);
+        memcpy(m_buffer + m_used, text.data(), length);
+        m_used += length;
+        text.remove_prefix(length);
+    }
+}
+
+// Formats a number straight into the buffer
+void FleetSink::putNumber(long value) {
+    const size_t DIGITS = 20; // sign and 19 digits of a 64-bit long
+    if (CHUNK - m_used < DIGITS) flush();
+    m_used = std::to_chars(m_buffer + m_used, m_buffer + CHUNK, value).ptr - m_buffer;
+}
+
+// Passes the buffered bytes on
+void FleetSink::flush() {
+    if (m_used) write(m_buffer, m_used);
+    m_used = 0;
+}
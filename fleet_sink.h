@@ -0,0 +1,41 @@
+#ifndef FLEET_SINK_H
+#define FLEET_SINK_H
+#include "fleet.h"
+#include <string_view>
+
+// Buffered text output for the dumps and exports. Text collects in a fixed
+// buffer and reaches write() in chunks of at most CHUNK bytes, so a large
+// fleet streams out with one call per chunk and no allocation; numbers are
+// formatted with std::to_chars. Derived sinks flush() in their destructor.
+class FleetSink{
+    public:
+    static const size_t CHUNK = 16384;
+    FleetSink() : m_used(0) {}
+    virtual ~FleetSink() {}
+    void put(char c) {
+        if (m_used == CHUNK) flush();
+        m_buffer[m_used++] = c;
+    }
+    void put(std::string_view text);
+    void putNumber(long value);
+    void flush();   // hands the buffered text to write()
+    protected:
+    virtual void write(const char* data, size_t length) = 0;
+    private:
+    FleetSink(const FleetSink&);
+    FleetSink& operator=(const FleetSink&);
+    char m_buffer[CHUNK];
+    size_t m_used;
+};
+
+// Sink writing to a std::ostream, one write() per chunk
+class OstreamSink : public FleetSink{
+    public:
+    explicit OstreamSink(std::ostream& out) : m_out(out) {}
+    ~OstreamSink() {flush();}
+    protected:
+    void write(const char* data, size_t length) {m_out.write(data, length);}
+    private:
+    std::ostream& m_out;
+};
+#endif
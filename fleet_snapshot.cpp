@@ -0,0 +1,63 @@
+#include "fleet_snapshot.h"
+#include <cstdlib>
+#include <new>
+
+static const size_t CACHE_LINE = 64;
+static const size_t KEYS_PER_LINE = CACHE_LINE / sizeof(int);
+
+// Lays the sorted run out in Eytzinger order. The implicit tree is walked in
+// order without a stack: go left (k -> 2k) while possible, then climb past
+// every level that was entered as a right child to reach the next node.
+FleetSnapshot::FleetSnapshot(const int* ids, const unsigned char* payload, size_t n) {
+    m_size = n;
+    m_block = ::operator new((n + 1) * sizeof(int) + CACHE_LINE + n + 1);
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(m_block) + CACHE_LINE - 1) & ~uintptr_t(CACHE_LINE - 1);
+    m_keys = reinterpret_cast<int*>(aligned);
+    m_payload = reinterpret_cast<unsigned char*>(m_keys + n + 1);
+    m_keys[0] = 0;
+    m_payload[0] = 0;
+
+    size_t k = 1;
+    while (2 * k <= n) k = 2 * k;
+    for (size_t i = 0; i < n; i++) {
+        m_keys[k] = ids[i];
+        m_payload[k] = payload[i];
+        if (2 * k + 1 <= n) {
+            k = 2 * k + 1; // Leftmost node of the right subtree comes next
+            while (2 * k <= n) k = 2 * k;
+        } else {
+            while (k & 1) k >>= 1; // Finished a right subtree
+            k >>= 1;
+        }
+    }
+}
+
+// Releases the key and payload block
+FleetSnapshot::~FleetSnapshot() {
+    ::operator delete(m_block);
+}
+
+// Branchless descent: the comparison result picks the child, and the
+// cache line holding the node's descendants four levels down is requested
+// ahead of time. The final index encodes the path; stripping the trailing
+// right turns and the last left turn leaves the lower bound of id.
+size_t FleetSnapshot::search(int id) const {
+    size_t k = 1;
+    while (k <= m_size) {
+#if defined(__GNUC__)
+        __builtin_prefetch(m_keys + (k * KEYS_PER_LINE < m_size ? k * KEYS_PER_LINE : 0));
+#endif
+        k = 2 * k + (m_keys[k] < id);
+    }
+    while (k & 1) k >>= 1;
+    k >>= 1;
+    return (k && m_keys[k] == id) ? k : 0;
+}
+
+// Copies a stored ship, touching the payload only on a hit
+bool FleetSnapshot::find(int id, Ship& out) const {
+    size_t k = search(id);
+    if (!k) return false;
+    out = Ship(id, static_cast<SHIPTYPE>(m_payload[k] & 7), static_cast<STATE>(m_payload[k] >> 3));
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef FLEET_SNAPSHOT_H
+#define FLEET_SNAPSHOT_H
+#include "fleet.h"
+
+// Immutable, read-optimized copy of a fleet published by Fleet::publish().
+// IDs are stored in Eytzinger (BFS) order in one cache-line aligned array,
+// so a lookup is a branchless walk k -> 2k or 2k+1 whose next levels can be
+// prefetched a whole cache line at a time. Type and state sit in a parallel
+// byte array and are only read on a hit. Snapshots never change after
+// construction and can be shared between reader threads.
+class FleetSnapshot{
+    public:
+    // ids must be sorted ascending, payload[i] packed with pack()
+    FleetSnapshot(const int* ids, const unsigned char* payload, size_t n);
+    ~FleetSnapshot();
+    size_t size() const {return m_size;}
+    bool contains(int id) const {return search(id) != 0;}
+    bool find(int id, Ship& out) const; // copies ID, type and state
+    static unsigned char pack(SHIPTYPE type, STATE state) {return (unsigned char)(state << 3 | type);}
+    private:
+    FleetSnapshot(const FleetSnapshot&);
+    FleetSnapshot& operator=(const FleetSnapshot&);
+    size_t search(int id) const;    // Eytzinger index of id, 0 if absent
+    void* m_block;          // raw allocation behind m_keys
+    int* m_keys;            // 1-based Eytzinger order, m_keys[0] unused
+    unsigned char* m_payload;   // packed type/state, same order as m_keys
+    size_t m_size;
+};
+#endif
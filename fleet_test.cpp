@@ -1,6 +1,24 @@
 #include "fleet.h"
+#include "fleet_compact.h"
+#include "fleet_snapshot.h"
+#include "fleet_concurrent.h"
+#include "fleet_sharded.h"
+#include "fleet_file.h"
+#include "fleet_journal.h"
+#include "fleet_sink.h"
+#include "fleet_version.h"
+#include "fleet_basic.h"
+#include "fleet_columns.h"
 #include <vector>
 #include <cstdlib>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <set>
+#include <map>
+#include <sstream>
+#include <string>
+#include <algorithm>
 
 class Tester {
 public:
@@ -14,6 +32,58 @@ public:
     bool testBSTRemoveEdgeCase();
     // Test case for AVL tree balance after removals
     bool testAVLRemove();
+    // Test case for node recycling in the fleet's ship pool
+    bool testPoolRecycling();
+    // Test case for duplicate handling in the single-pass inserts
+    bool testInsertDuplicates();
+    // Test case for a degenerate BST built from sorted IDs
+    bool testSortedBSTDepth();
+    // Test case for the public lookups and the batched lookup
+    bool testFindAndFindMany();
+    // Test case for the DENSE table and conversions to and from it
+    bool testDenseType();
+    // Test case for bulk loading and the AVL conversion rebuild
+    bool testBulkLoad();
+    // Test case for the index-based compact AVL store
+    bool testCompactFleet();
+    // Test case for publishing Eytzinger snapshots
+    bool testSnapshotPublish();
+    // Test case for lock-free readers running alongside a writer
+    bool testConcurrentReaders();
+    // Test case for the sharded fleet and its parallel batches
+    bool testShardedFleet();
+    // Test case for batches sent to one sharded fleet from two threads
+    bool testShardedConcurrentBatches();
+    // Test case for ordered iterators, bounds and range scans
+    bool testIterators();
+    // Test case for range scans that start above the ships they pass
+    bool testRangeAboveAll();
+    // Test case for subtree sizes and the rank/select/count queries
+    bool testOrderStatistics();
+    // Test case for the per-type and per-state totals
+    bool testTotals();
+    // Test case for the batched mutation entry points
+    bool testApplyUpdates();
+    // Test case for in-place state/type updates and upserts
+    bool testInPlaceUpdates();
+    // Test case for saving, loading and mapping fleet files
+    bool testSaveLoad();
+    // Test case for journal replay, compaction and torn journal tails
+    bool testJournal();
+    // Test case for the buffered dump and the CSV/JSON lines export
+    bool testDumpAndExport();
+    // Test case for copy-on-write versions and their reclamation
+    bool testVersions();
+    // Test case for merge, intersect and difference between fleets
+    bool testSetOperations();
+    // Test case for the operation counters and the measured tree shape
+    bool testStats();
+    // Test case for the compile-time BST, AVL and splay engines
+    bool testBasicFleet();
+    // Test case for the BTREE layout and its B+-tree table
+    bool testBTree();
+    // Test case for the columnar copy and its filter kernels
+    bool testColumns();
 
 private:
     // Helper to collect all nodes from a tree
@@ -22,6 +92,12 @@ private:
     bool isBSTHelper(Ship* root, int min, int max);
     // Helper to check if an AVL tree is balanced
     bool isBalanced(Ship* root);
+    // Helper to validate a compact subtree, returns its height or -2 on failure
+    int compactHeight(const CompactFleet& fleet, uint32_t node, int min, int max);
+    // Helper to compare two fleets ship by ship in ID order
+    bool sameShips(const Fleet& a, const Fleet& b);
+    // Helper to dump a subtree the way the old recursive dump did
+    void dumpRecursive(const Ship* node, std::string& out);
 
     bool checker = true;
 };
@@ -62,6 +138,18 @@ bool Tester::isBalanced(Ship* root) {
     return isBalanced(root->m_left) && isBalanced(root->m_right);
 }
 
+// Recursive helper checking order, stored heights and balance of a compact subtree
+int Tester::compactHeight(const CompactFleet& fleet, uint32_t node, int min, int max) {
+    if (node == CompactFleet::NIL) return 0;
+    int id = fleet.m_keys[node].id;
+    if (id < min || id > max) return -2;
+    int left = compactHeight(fleet, fleet.m_keys[node].left, min, id - 1);
+    int right = compactHeight(fleet, fleet.m_keys[node].right, id + 1, max);
+    if (left < 0 || right < 0 || abs(left - right) > 1) return -2;
+    int height = std::max(left, right) + 1;
+    return (fleet.m_height[node] == height) ? height : -2;
+}
+
 // Tests if an AVL tree remains balanced after a large number of random insertions
 bool Tester::testAVLTreeBalance() {
     Fleet fleet(AVL);
@@ -122,6 +210,1078 @@ bool Tester::testAVLRemove() {
     return (isBalanced(fleet.m_root) || checker);
 }
 
+// Tests that removed nodes are recycled by the pool and clear() releases everything
+bool Tester::testPoolRecycling() {
+    Fleet fleet(AVL);
+    for (int id = MINID; id < MINID + 2000; id++)
+        fleet.insert(Ship(id));
+    size_t capacity = fleet.m_pool.capacity();
+    for (int id = MINID; id < MINID + 1000; id++)
+        fleet.remove(id);
+    for (int id = MINID + 5000; id < MINID + 6000; id++)
+        fleet.insert(Ship(id));
+    // Re-adding as many ships as were removed must not grow the pool
+    if (fleet.m_pool.capacity() != capacity || fleet.m_pool.live() != 2000) return false;
+    Fleet copy(fleet);
+    if (copy.m_pool.live() != 2000 || !isBalanced(copy.m_root)) return false;
+    fleet.clear();
+    return fleet.m_root == nullptr && fleet.m_pool.live() == 0 && fleet.m_pool.capacity() == 0;
+}
+
+// Tests that every tree type rejects duplicates without allocating a node
+bool Tester::testInsertDuplicates() {
+    const TREETYPE types[] = {BST, AVL, SPLAY};
+    for (int t = 0; t < 3; t++) {
+        Fleet fleet(types[t]);
+        for (int id = MINID; id < MINID + 500; id++)
+            fleet.insert(Ship(id));
+        for (int id = MINID; id < MINID + 500; id += 7)
+            fleet.insert(Ship(id, TELESCOPE, LOST));
+        if (fleet.m_pool.live() != 500) return false;
+        if (fleet.findShip(fleet.m_root, MINID + 7)->m_type != CARGO) return false;
+        if (!isBSTHelper(fleet.m_root, MINID, MAXID)) return false;
+        if (types[t] == SPLAY) {
+            // A fresh insert must end up at the root
+            fleet.insert(Ship(MINID + 600));
+            if (fleet.m_root->m_id != MINID + 600) return false;
+        }
+    }
+    return true;
+}
+
+// Tests that a fully degenerate BST can be copied, searched and emptied
+// without recursion
+bool Tester::testSortedBSTDepth() {
+    const int count = 20000;
+    Fleet fleet(BST);
+    for (int id = MINID; id < MINID + count; id++)
+        fleet.insert(Ship(id));
+    if (fleet.m_root->m_height != count - 1) return false;
+    Fleet copy(fleet);
+    if (!copy.findShip(copy.m_root, MINID + count - 1)) return false;
+    for (int id = MINID; id < MINID + count; id++)
+        copy.remove(id);
+    return copy.m_root == nullptr && fleet.m_pool.live() == size_t(count);
+}
+
+// Tests find/contains for every tree type, splay-on-access, and that
+// findMany agrees with single lookups on a mixed batch
+bool Tester::testFindAndFindMany() {
+    const TREETYPE types[] = {BST, AVL, SPLAY};
+    for (int t = 0; t < 3; t++) {
+        Fleet fleet(types[t]);
+        for (int i = 0; i < 400; i++)
+            fleet.insert(Ship(rand() % (MAXID - MINID + 1) + MINID, static_cast<SHIPTYPE>(i % 5)));
+        std::vector<int> ids;
+        for (int i = 0; i < 600; i++)
+            ids.push_back(rand() % (MAXID - MINID + 1) + MINID);
+        ids.push_back(MINID - 1);
+        ids.push_back(fleet.m_root->m_id);
+        ids.push_back(fleet.m_root->m_id); // repeated probe
+        std::vector<const Ship*> out(ids.size());
+        fleet.findMany(ids.data(), ids.size(), out.data());
+        for (size_t i = 0; i < ids.size(); i++)
+            if (out[i] != fleet.findShip(fleet.m_root, ids[i])) return false;
+        int present = fleet.findMin(fleet.m_root)->m_id;
+        const Ship* found = fleet.find(present);
+        if (!found || found->m_id != present || !fleet.contains(present) || fleet.contains(MINID - 1)) return false;
+        // Only splay trees restructure on access
+        if ((types[t] == SPLAY) != (fleet.m_root->m_id == present)) return false;
+    }
+    return true;
+}
+
+// Tests DENSE inserts/removes/lookups and round trips through the tree layouts
+bool Tester::testDenseType() {
+    Fleet fleet(DENSE);
+    std::vector<int> ids;
+    for (int i = 0; i < 1000; i++) {
+        int id = rand() % (MAXID - MINID + 1) + MINID;
+        fleet.insert(Ship(id, static_cast<SHIPTYPE>(id % 5), (id % 3) ? ALIVE : LOST));
+        ids.push_back(id);
+    }
+    fleet.insert(Ship(MINID, ROBOCARRIER, LOST));
+    fleet.insert(Ship(MAXID, TELESCOPE));
+    fleet.insert(Ship(MAXID + 1));
+    fleet.remove(ids[0]);
+    if (fleet.contains(ids[0]) || !fleet.contains(MAXID) || fleet.contains(MAXID + 1)) return false;
+    const Ship* edge = fleet.find(MINID);
+    if (!edge || edge->getType() != ROBOCARRIER || edge->getState() != LOST) return false;
+    size_t count = fleet.m_dense.size();
+
+    // DENSE -> AVL must give a balanced tree holding the same ships
+    fleet.setType(AVL);
+    std::vector<Ship*> nodes = getAllNodes(fleet.m_root);
+    if (nodes.size() != count || !isBSTHelper(fleet.m_root, MINID, MAXID)) return false;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        int id = nodes[i]->m_id;
+        int left = nodes[i]->m_left ? nodes[i]->m_left->m_height : -1;
+        int right = nodes[i]->m_right ? nodes[i]->m_right->m_height : -1;
+        if (nodes[i]->m_height != std::max(left, right) + 1 || abs(left - right) > 1) return false;
+        if (id != MINID && id != MAXID && (nodes[i]->m_type != id % 5 || nodes[i]->m_state != ((id % 3) ? ALIVE : LOST)))
+            return false;
+    }
+    // BST -> DENSE drops every node
+    fleet.setType(BST);
+    fleet.setType(DENSE);
+    return fleet.m_root == nullptr && fleet.m_pool.live() == 0 && fleet.m_dense.size() == count &&
+           fleet.m_dense.next(MINID) == MINID && fleet.m_dense.prev(MAXID) == MAXID;
+}
+
+// Tests that bulkLoad merges with existing ships, skips bad input and
+// leaves a perfectly balanced tree; also converts a degenerate BST to AVL
+bool Tester::testBulkLoad() {
+    Fleet fleet(SPLAY);
+    for (int id = MINID; id < MINID + 100; id++)
+        fleet.insert(Ship(id, CARGO));
+    Ship* kept = fleet.findShip(fleet.m_root, MINID + 50);
+    std::vector<Ship> batch;
+    for (int i = 0; i < 3000; i++)
+        batch.push_back(Ship(rand() % (MAXID - MINID + 1) + MINID, TELESCOPE));
+    batch.push_back(Ship(MINID + 50, FUELCARRIER)); // Already present
+    batch.push_back(Ship(MAXID + 1));               // Invalid
+    batch.push_back(batch[0]);                      // Repeated
+    fleet.bulkLoad(batch.data(), batch.size());
+
+    std::vector<Ship*> nodes = getAllNodes(fleet.m_root);
+    if (nodes.size() != fleet.m_pool.live() || !isBSTHelper(fleet.m_root, MINID, MAXID)) return false;
+    // The existing node is reused with its original data
+    if (fleet.findShip(fleet.m_root, MINID + 50) != kept || kept->m_type != CARGO) return false;
+    if (fleet.m_root->m_height > 12) return false; // floor(log2 n) for n < 8192
+    for (size_t i = 0; i < nodes.size(); i++) {
+        int left = nodes[i]->m_left ? nodes[i]->m_left->m_height : -1;
+        int right = nodes[i]->m_right ? nodes[i]->m_right->m_height : -1;
+        if (nodes[i]->m_height != std::max(left, right) + 1 || abs(left - right) > 1) return false;
+    }
+    // Loading only known or invalid IDs changes nothing, so the published
+    // snapshot stays current
+    std::shared_ptr<const FleetSnapshot> published = fleet.publish();
+    fleet.bulkLoad(batch.data(), batch.size());
+    if (fleet.publish() != published || fleet.m_pool.live() != nodes.size()) return false;
+
+    Fleet chain(BST);
+    for (int id = MINID; id < MINID + 1000; id++)
+        chain.insert(Ship(id));
+    chain.setType(AVL);
+    return chain.m_root->m_height == 9 && isBalanced(chain.m_root) && chain.m_pool.live() == 1000;
+}
+
+// Tests the compact store against a regular AVL fleet under random updates
+bool Tester::testCompactFleet() {
+    CompactFleet compact;
+    Fleet fleet(AVL);
+    for (int i = 0; i < 5000; i++) {
+        int id = rand() % 3000 + MINID;
+        if (rand() % 3) {
+            Ship ship(id, static_cast<SHIPTYPE>(id % 5), (id % 2) ? LOST : ALIVE);
+            compact.insert(ship);
+            fleet.insert(ship);
+        } else {
+            compact.remove(id);
+            fleet.remove(id);
+        }
+    }
+    if (compactHeight(compact, compact.m_root, MINID, MAXID) < 0) return false;
+    if (compact.size() != fleet.m_pool.live() || compact.insert(Ship(MAXID + 1))) return false;
+    for (int id = MINID; id < MINID + 3000; id++) {
+        Ship ship;
+        bool found = compact.find(id, ship);
+        if (found != fleet.contains(id)) return false;
+        if (found && (ship.getType() != id % 5 || ship.getState() != ((id % 2) ? LOST : ALIVE))) return false;
+    }
+    return true;
+}
+
+// Tests that snapshots answer like the fleet and are only rebuilt after a change
+bool Tester::testSnapshotPublish() {
+    const TREETYPE types[] = {AVL, DENSE};
+    for (int t = 0; t < 2; t++) {
+        Fleet fleet(types[t]);
+        if (fleet.publish()->size() != 0 || fleet.publish()->contains(MINID)) return false;
+        int present = MINID + 4242;
+        fleet.insert(Ship(present, static_cast<SHIPTYPE>(present % 5), (present % 2) ? LOST : ALIVE));
+        for (int i = 0; i < 777; i++) {
+            int id = rand() % 5000 + MINID;
+            fleet.insert(Ship(id, static_cast<SHIPTYPE>(id % 5), (id % 2) ? LOST : ALIVE));
+        }
+        std::shared_ptr<const FleetSnapshot> first = fleet.publish();
+        if (fleet.publish() != first) return false;
+        fleet.insert(Ship(present)); // Duplicate, nothing changes
+        if (fleet.publish() != first) return false;
+        for (int id = MINID - 1; id <= MINID + 5000; id++) {
+            Ship ship;
+            bool found = first->find(id, ship);
+            if (found != fleet.contains(id)) return false;
+            if (found && (ship.getType() != id % 5 || ship.getState() != ((id % 2) ? LOST : ALIVE))) return false;
+        }
+        fleet.remove(present);
+        std::shared_ptr<const FleetSnapshot> second = fleet.publish();
+        if (second == first || second->contains(present) || !first->contains(present)) return false;
+    }
+    return true;
+}
+
+// Tests that readers always see ships that are never removed while a writer
+// churns other IDs, and that the final tree is a valid AVL tree
+bool Tester::testConcurrentReaders() {
+    ConcurrentFleet fleet;
+    for (int id = MINID; id < MINID + 1000; id += 2)
+        fleet.insert(Ship(id, TELESCOPE)); // Even IDs stay for the whole test
+    std::atomic<bool> done(false);
+    std::atomic<int> misses(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; r++) {
+        readers.push_back(std::thread([&fleet, &done, &misses, r]() {
+            int id = MINID + 2 * r;
+            while (!done.load()) {
+                Ship ship;
+                if (!fleet.find(id, ship) || ship.getType() != TELESCOPE) misses++;
+                id = (id + 2 >= MINID + 1000) ? MINID : id + 2;
+            }
+        }));
+    }
+    for (int round = 0; round < 20; round++) {
+        for (int id = MINID + 1; id < MINID + 1000; id += 2) fleet.insert(Ship(id));
+        for (int id = MINID + 1; id < MINID + 1000; id += 4) fleet.remove(id);
+        for (int id = MINID + 3; id < MINID + 1000; id += 4) fleet.remove(id);
+    }
+    done.store(true);
+    for (size_t r = 0; r < readers.size(); r++) readers[r].join();
+
+    std::vector<const ConcurrentFleet::Node*> pending(1, fleet.m_root.load());
+    size_t count = 0;
+    while (!pending.empty()) {
+        const ConcurrentFleet::Node* node = pending.back();
+        pending.pop_back();
+        if (!node) continue;
+        count++;
+        int left = ConcurrentFleet::height(node->left), right = ConcurrentFleet::height(node->right);
+        if (abs(left - right) > 1 || node->height != std::max(left, right) + 1) return false;
+        pending.push_back(node->left);
+        pending.push_back(node->right);
+    }
+    if (misses.load() != 0 || count != 500 || fleet.size() != 500 || fleet.contains(MINID + 1)) return false;
+
+    // With every slot taken a reader falls back to the overflow slot, which
+    // holds back reclamation until it leaves
+    std::vector<int> slots;
+    for (int i = 0; i < ConcurrentFleet::READER_SLOTS; i++) slots.push_back(fleet.enter());
+    int overflow = fleet.enter();
+    if (overflow != ConcurrentFleet::OVERFLOW_SLOT) return false;
+    for (size_t i = 0; i < slots.size(); i++) fleet.leave(slots[i]);
+    fleet.remove(MINID);
+    if (fleet.m_retired.empty() || !fleet.contains(MINID + 2)) return false;
+    fleet.leave(overflow);
+    fleet.remove(MINID + 2);
+    return fleet.m_retired.empty() && fleet.m_overflow.load() == 0;
+}
+
+// Tests that a sharded fleet with mixed shard layouts matches a plain fleet
+// after parallel batches, and that range scans cross shards in ID order
+bool Tester::testShardedFleet() {
+    ShardedFleet sharded(4, AVL, 3);
+    sharded.setShardType(1, DENSE);
+    sharded.setShardType(2, SPLAY);
+    Fleet fleet(AVL);
+    std::vector<Ship> batch;
+    for (int i = 0; i < 20000; i++) {
+        int id = rand() % (MAXID - MINID + 1) + MINID;
+        batch.push_back(Ship(id, static_cast<SHIPTYPE>(id % 5)));
+        fleet.insert(batch.back());
+    }
+    batch.push_back(Ship(MINID - 1)); // Invalid IDs are dropped
+    sharded.insertMany(&batch[0], batch.size());
+    std::vector<int> ids;
+    for (size_t i = 0; i < batch.size(); i += 3) {
+        ids.push_back(batch[i].getID());
+        fleet.remove(batch[i].getID());
+    }
+    sharded.removeMany(&ids[0], ids.size());
+    sharded.insert(Ship(MAXID));
+    fleet.insert(Ship(MAXID));
+    if (sharded.size() != fleet.size()) return false;
+
+    std::vector<int> expected, seen;
+    int lo = MINID + 20000, hi = MAXID - 20000;
+    fleet.forEachInRange(lo, hi, [&expected](const Ship& ship) { expected.push_back(ship.getID()); });
+    sharded.forEachInRange(lo, hi, [&seen](const Ship& ship) { seen.push_back(ship.getID()); });
+    if (seen != expected || seen.empty()) return false;
+    for (size_t i = 0; i < batch.size(); i += 7)
+        if (sharded.contains(batch[i].getID()) != fleet.contains(batch[i].getID())) return false;
+    return sharded.contains(MAXID) && !sharded.contains(MINID - 1);
+}
+
+// Tests that two threads inserting disjoint batches at the same time both
+// land completely, then remove them again concurrently
+bool Tester::testShardedConcurrentBatches() {
+    ShardedFleet sharded(8, AVL, 4);
+    std::vector<Ship> batches[2];
+    std::vector<int> ids[2];
+    for (int i = 0; i < 4000; i++) {
+        for (int b = 0; b < 2; b++) {
+            batches[b].push_back(Ship(MINID + 2 * i + b));
+            if (i % 2) ids[b].push_back(MINID + 2 * i + b);
+        }
+    }
+    for (int round = 0; round < 20; round++) {
+        std::thread other([&sharded, &batches]() { sharded.insertMany(&batches[1][0], batches[1].size()); });
+        sharded.insertMany(&batches[0][0], batches[0].size());
+        other.join();
+        if (sharded.size() != 8000) return false;
+        std::vector<int> seen;
+        sharded.forEachInRange(MINID, MAXID, [&seen](const Ship& ship) { seen.push_back(ship.getID()); });
+        for (size_t i = 0; i < seen.size(); i++)
+            if (seen[i] != MINID + int(i)) return false;
+        std::thread remover([&sharded, &ids]() { sharded.removeMany(&ids[1][0], ids[1].size()); });
+        sharded.removeMany(&ids[0][0], ids[0].size());
+        remover.join();
+        if (sharded.size() != 4000 || sharded.contains(MINID + 2) || !sharded.contains(MINID + 1)) return false;
+    }
+    return true;
+}
+
+// Tests iterators in both directions, the bounds and range scans against a
+// std::set for every layout, and that iterating a SPLAY fleet never splays
+bool Tester::testIterators() {
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        if (fleet.begin() != fleet.end() || fleet.lowerBound(MINID) != fleet.end()) return false;
+        std::set<int> ids;
+        for (int i = 0; i < 2000; i++) {
+            int id = rand() % 10000 + MINID;
+            ids.insert(id);
+            fleet.insert(Ship(id, static_cast<SHIPTYPE>(id % 5)));
+        }
+        Ship* root = fleet.m_root;
+        std::set<int>::const_iterator expected = ids.begin();
+        for (Fleet::const_iterator it = fleet.begin(); it != fleet.end(); ++it, ++expected)
+            if (expected == ids.end() || it->getID() != *expected || it->getType() != *expected % 5) return false;
+        if (expected != ids.end()) return false;
+        std::set<int>::const_reverse_iterator back = ids.rbegin();
+        Fleet::const_iterator it = fleet.end();
+        do {
+            --it;
+            if (it->getID() != *back++) return false;
+        } while (it != fleet.begin());
+        if (back != ids.rend()) return false;
+        for (int probe = MINID - 5; probe < MINID + 10010; probe += 37) {
+            std::set<int>::const_iterator lower = ids.lower_bound(probe), upper = ids.upper_bound(probe);
+            Fleet::const_iterator lowerIt = fleet.lowerBound(probe), upperIt = fleet.upperBound(probe);
+            if ((lower == ids.end()) != (lowerIt == fleet.end())) return false;
+            if (lower != ids.end() && lowerIt->getID() != *lower) return false;
+            if ((upper == ids.end()) != (upperIt == fleet.end())) return false;
+            if (upper != ids.end() && upperIt->getID() != *upper) return false;
+        }
+        std::vector<int> seen;
+        fleet.forEachInRange(MINID + 2500, MINID + 7500, [&seen](const Ship& ship) { seen.push_back(ship.getID()); });
+        if (seen != std::vector<int>(ids.lower_bound(MINID + 2500), ids.upper_bound(MINID + 7500))) return false;
+        if (fleet.m_root != root) return false;
+    }
+    return true;
+}
+
+// Tests range scans starting above every ship, or above every ship on the
+// right spine from some node down, where the pruned walk runs off the tree
+// with nothing left on its stack
+bool Tester::testRangeAboveAll() {
+    const TREETYPE types[] = {BST, AVL, SPLAY};
+    for (int t = 0; t < 3; t++) {
+        Fleet fleet(types[t]);
+        int calls = 0;
+        fleet.forEachInRange(MINID, MAXID, [&calls](const Ship&) { calls++; });
+        std::set<int> ids;
+        for (int i = 0; i < 3000; i++) {
+            int id = rand() % 5000 + MINID;
+            fleet.insert(Ship(id));
+            ids.insert(id);
+        }
+        int maxID = *ids.rbegin();
+        fleet.forEachInRange(maxID + 1, MAXID, [&calls](const Ship&) { calls++; });
+        if (calls != 0) return false;
+        // Past each right spine node only its right subtree can match
+        for (const Ship* node = fleet.m_root; node; node = node->m_right) {
+            std::vector<int> seen;
+            fleet.forEachInRange(node->m_id + 1, MAXID, [&seen](const Ship& ship) { seen.push_back(ship.getID()); });
+            if (seen != std::vector<int>(ids.upper_bound(node->m_id), ids.end())) return false;
+        }
+    }
+    return true;
+}
+
+// Tests that subtree sizes survive inserts, removes, splays and rebuilds,
+// and that rank, select and countInRange agree with a std::set
+bool Tester::testOrderStatistics() {
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        std::set<int> ids;
+        for (int i = 0; i < 6000; i++) {
+            int id = rand() % 4000 + MINID;
+            if (i % 3 == 2) {
+                fleet.remove(id);
+                ids.erase(id);
+            } else {
+                fleet.insert(Ship(id));
+                ids.insert(id);
+            }
+            if (i % 5 == 0) fleet.contains(rand() % 4000 + MINID);
+        }
+        if (types[t] == BST) fleet.setType(AVL); // Rebuilt from scratch
+        std::vector<Ship*> nodes = getAllNodes(fleet.m_root);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            int left = nodes[i]->m_left ? nodes[i]->m_left->m_size : 0;
+            int right = nodes[i]->m_right ? nodes[i]->m_right->m_size : 0;
+            if (nodes[i]->m_size != left + right + 1) return false;
+        }
+        std::vector<int> sorted(ids.begin(), ids.end());
+        for (size_t k = 0; k < sorted.size(); k += 7)
+            if (fleet.select(k)->getID() != sorted[k] || fleet.rank(sorted[k]) != k) return false;
+        if (fleet.select(sorted.size()) != fleet.end()) return false;
+        Fleet::const_iterator page = fleet.select(sorted.size() - 2);
+        if (++page == fleet.end() || page->getID() != sorted.back() || ++page != fleet.end()) return false;
+        for (int lo = MINID - 50; lo < MINID + 4100; lo += 97) {
+            int hi = lo + rand() % 500;
+            size_t expected = std::distance(ids.lower_bound(lo), ids.upper_bound(hi));
+            if (fleet.countInRange(lo, hi) != expected) return false;
+        }
+        if (fleet.countInRange(MINID, MAXID) != ids.size() || fleet.countInRange(MINID + 9, MINID + 8) != 0) return false;
+    }
+    return true;
+}
+
+// Tests that type/state totals over the fleet and over ID ranges match a
+// brute-force count after inserts, removes, in-place updates and a rebuild
+bool Tester::testTotals() {
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        for (int i = 0; i < 5000; i++) {
+            int id = rand() % 3000 + MINID;
+            if (i % 4 == 3) fleet.remove(id);
+            else fleet.insert(Ship(id, static_cast<SHIPTYPE>(rand() % SHIPTYPES), (rand() % 3) ? ALIVE : LOST));
+            if (i % 7 == 0) fleet.contains(rand() % 3000 + MINID);
+        }
+        for (int id = MINID; id < MINID + 3000; id += 11)
+            fleet.updateType(id, static_cast<SHIPTYPE>(id % SHIPTYPES)) && fleet.updateState(id, LOST);
+        if (types[t] == BST) fleet.setType(AVL);
+        for (int lo = MINID - 100; lo < MINID + 3100; lo += 173) {
+            int hi = (lo == MINID - 100) ? MAXID : lo + rand() % 800;
+            FleetTotals expected = FleetTotals();
+            fleet.forEachInRange(lo, hi, [&expected](const Ship& ship) {
+                expected.ships++;
+                expected.byType[ship.getType()]++;
+                expected.byState[ship.getState()]++;
+            });
+            FleetTotals range = (hi == MAXID) ? fleet.totals() : fleet.totalsInRange(lo, hi);
+            if (range.ships != expected.ships || range.byState[ALIVE] != expected.byState[ALIVE] ||
+                range.byState[LOST] != expected.byState[LOST])
+                return false;
+            for (int type = 0; type < SHIPTYPES; type++)
+                if (range.byType[type] != expected.byType[type]) return false;
+        }
+    }
+    return true;
+}
+
+// Tests batches of mixed events, small enough to be applied per ID and
+// large enough to rebuild, against replaying them one by one on a std::map
+bool Tester::testApplyUpdates() {
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    const size_t sizes[] = {1, 7, 60, 900, 5000};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        std::map<int, std::pair<SHIPTYPE, STATE> > expected;
+        for (int round = 0; round < 10; round++) {
+            std::vector<FleetUpdate> batch(sizes[round % 5]);
+            for (size_t i = 0; i < batch.size(); i++) {
+                int id = rand() % 2000 + MINID - 5; // A few invalid IDs
+                batch[i].op = static_cast<UPDATEOP>(rand() % 6);
+                batch[i].ship = Ship(id, static_cast<SHIPTYPE>(rand() % SHIPTYPES), (rand() % 2) ? ALIVE : LOST);
+                if (id < MINID) continue;
+                bool present = expected.count(id) != 0;
+                SHIPTYPE type = batch[i].ship.getType();
+                STATE state = batch[i].ship.getState();
+                if (batch[i].op == SETSTATE && present) type = expected[id].first;
+                if (batch[i].op == SETTYPE && present) state = expected[id].second;
+                if (batch[i].op == REMOVESHIP) expected.erase(id);
+                else if (batch[i].op == UPSERTSHIP || (batch[i].op == ADDSHIP ? !present : present))
+                    expected[id] = std::make_pair(type, state);
+            }
+            fleet.applyUpdates(&batch[0], batch.size());
+        }
+        std::vector<Ship> adds;
+        std::vector<int> drops;
+        for (int id = MINID; id < MINID + 2000; id += 3) {
+            adds.push_back(Ship(id, TELESCOPE, LOST));
+            drops.push_back(id + 1);
+            if (!expected.count(id)) expected[id] = std::make_pair(TELESCOPE, LOST);
+            expected.erase(id + 1);
+        }
+        fleet.insertMany(&adds[0], adds.size());
+        fleet.removeMany(&drops[0], drops.size());
+
+        if (fleet.size() != expected.size() || fleet.totals().ships != expected.size()) return false;
+        std::map<int, std::pair<SHIPTYPE, STATE> >::const_iterator want = expected.begin();
+        for (Fleet::const_iterator it = fleet.begin(); it != fleet.end(); ++it, ++want) {
+            if (it->getID() != want->first || it->getType() != want->second.first || it->getState() != want->second.second)
+                return false;
+        }
+        if (types[t] == AVL && !isBalanced(fleet.m_root)) return false;
+    }
+    return true;
+}
+
+// Tests that updates and upserts of stored ships keep their nodes and the
+// tree shape, and change only what they were asked to
+bool Tester::testInPlaceUpdates() {
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        for (int id = MINID; id < MINID + 500; id++) fleet.insert(Ship(id, CARGO, ALIVE));
+        Ship* root = fleet.m_root;
+        size_t live = fleet.m_pool.live();
+        for (int id = MINID; id < MINID + 500; id += 2) {
+            if (!fleet.updateState(id, LOST)) return false;
+            if (!fleet.updateType(id + 1, ROBOCARRIER)) return false;
+        }
+        if (fleet.updateState(MINID + 500, LOST) || fleet.updateType(MINID - 1, CARGO)) return false;
+        fleet.upsert(Ship(MINID + 7, FUELCARRIER, ALIVE)); // Overwrites
+        if (types[t] != SPLAY && (fleet.m_root != root || fleet.m_pool.live() != live)) return false;
+        fleet.upsert(Ship(MINID + 600, TELESCOPE, LOST));  // Inserts
+        for (int id = MINID; id < MINID + 500; id++) {
+            const Ship* ship = fleet.find(id);
+            SHIPTYPE type = (id == MINID + 7) ? FUELCARRIER : (id % 2) ? ROBOCARRIER : CARGO;
+            STATE state = (id == MINID + 7 || id % 2) ? ALIVE : LOST;
+            if (!ship || ship->getType() != type || ship->getState() != state) return false;
+        }
+        const Ship* added = fleet.find(MINID + 600);
+        if (!added || added->getType() != TELESCOPE || added->getState() != LOST) return false;
+        FleetTotals totals = fleet.totals();
+        if (totals.ships != 501 || totals.byState[LOST] != 251 || totals.byType[ROBOCARRIER] != 249) return false;
+    }
+    return true;
+}
+
+// Tests that a saved fleet loads back into every layout as a balanced tree,
+// that the mapped read-only fleet answers the same lookups, and that damaged
+// files are rejected without touching the fleet
+bool Tester::testSaveLoad() {
+    const char* path = "fleet_test.fleet";
+    Fleet source(SPLAY);
+    for (int i = 0; i < 3000; i++) {
+        int id = rand() % 20000 + MINID;
+        source.insert(Ship(id, static_cast<SHIPTYPE>(id % 5), (id % 3) ? ALIVE : LOST));
+    }
+    if (!source.save(path)) return false;
+    const TREETYPE types[] = {NONE, BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 6; t++) {
+        Fleet fleet(types[t]);
+        fleet.insert(Ship(MAXID)); // Replaced by the load
+        if (!fleet.load(path) || fleet.size() != source.size()) return false;
+        if (types[t] != DENSE && types[t] != BTREE && (!isBalanced(fleet.m_root) || !isBSTHelper(fleet.m_root, MINID, MAXID))) return false;
+        Fleet::const_iterator it = fleet.begin();
+        for (Fleet::const_iterator want = source.begin(); want != source.end(); ++want, ++it)
+            if (it->getID() != want->getID() || it->getType() != want->getType() || it->getState() != want->getState())
+                return false;
+    }
+    MappedFleet mapped;
+    if (!mapped.open(path) || mapped.size() != source.size()) return false;
+    for (int id = MINID - 1; id <= MINID + 20000; id++) {
+        Ship ship;
+        bool found = mapped.find(id, ship);
+        if (found != source.contains(id)) return false;
+        if (found && (ship.getType() != id % 5 || ship.getState() != ((id % 3) ? ALIVE : LOST))) return false;
+    }
+    mapped.close();
+
+    // Flip one payload byte, then cut the file short
+    FILE* file = fopen(path, "r+b");
+    if (!file) return false;
+    fseek(file, -1, SEEK_END);
+    int last = fgetc(file);
+    fseek(file, -1, SEEK_END);
+    fputc(last ^ 1, file);
+    fclose(file);
+    Fleet kept(AVL);
+    kept.insert(Ship(MINID));
+    bool rejected = !mapped.open(path) && !kept.load(path) && kept.size() == 1;
+    file = fopen(path, "wb");
+    if (file) fclose(file);
+    rejected = rejected && !mapped.open(path) && !kept.load("fleet_test.missing");
+    std::remove(path);
+    return rejected;
+}
+
+// Helper function to compare the IDs, types and states of two fleets
+bool Tester::sameShips(const Fleet& a, const Fleet& b) {
+    if (a.size() != b.size()) return false;
+    Fleet::const_iterator it = b.begin();
+    for (Fleet::const_iterator want = a.begin(); want != a.end(); ++want, ++it)
+        if (it->getID() != want->getID() || it->getType() != want->getType() || it->getState() != want->getState())
+            return false;
+    return true;
+}
+
+// Helper function to dump a subtree as nested (id:height) groups
+void Tester::dumpRecursive(const Ship* node, std::string& out) {
+    if (!node) return;
+    out += "(";
+    dumpRecursive(node->getLeft(), out);
+    out += std::to_string(node->getID()) + ":" + std::to_string(node->getHeight());
+    dumpRecursive(node->getRight(), out);
+    out += ")";
+}
+
+bool Tester::testJournal() {
+    const char* snapshotPath = "fleet_test.snapshot";
+    const char* journalPath = "fleet_test.journal";
+    std::remove(snapshotPath);
+    std::remove(journalPath);
+    Fleet reference(AVL);
+    Fleet fleet(AVL);
+    FleetJournal journal(16);
+    if (!journal.recover(fleet, snapshotPath, journalPath) || fleet.size() != 0) return false;
+    // Every mutation path, mirrored on an unjournaled fleet
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 2000; i++) {
+            int id = rand() % 3000 + MINID;
+            SHIPTYPE type = static_cast<SHIPTYPE>(rand() % SHIPTYPES);
+            STATE state = (rand() % 2) ? ALIVE : LOST;
+            switch (rand() % 5) {
+                case 0: fleet.insert(Ship(id, type, state)); reference.insert(Ship(id, type, state)); break;
+                case 1: fleet.remove(id); reference.remove(id); break;
+                case 2: fleet.updateState(id, state); reference.updateState(id, state); break;
+                case 3: fleet.updateType(id, type); reference.updateType(id, type); break;
+                default: fleet.upsert(Ship(id, type, state)); reference.upsert(Ship(id, type, state)); break;
+            }
+        }
+        vector<FleetUpdate> batch;
+        for (int i = 0; i < 1500; i++) {
+            FleetUpdate update = {static_cast<UPDATEOP>(rand() % 6), Ship(rand() % 3000 + MINID,
+                                  static_cast<SHIPTYPE>(rand() % SHIPTYPES), (rand() % 2) ? ALIVE : LOST)};
+            batch.push_back(update);
+        }
+        fleet.applyUpdates(batch);
+        reference.applyUpdates(batch);
+        // The first round restarts from the journal alone, the second from
+        // a compacted snapshot plus the records written after it
+        if (round == 0) {
+            journal.close();
+            Fleet restarted(SPLAY);
+            if (!journal.recover(restarted, snapshotPath, journalPath) || !sameShips(reference, restarted)) return false;
+            journal.close();
+            if (!journal.recover(fleet, snapshotPath, journalPath) || !journal.compact(snapshotPath)) return false;
+        }
+    }
+    journal.close();
+    Fleet restarted(DENSE);
+    if (!journal.recover(restarted, snapshotPath, journalPath) || !sameShips(reference, restarted)) return false;
+    journal.close();
+
+    // A torn group at the end is dropped and cut off on recovery
+    FILE* file = fopen(journalPath, "ab");
+    if (!file) return false;
+    long intact = ftell(file);
+    const unsigned char torn[12] = {4, 0, 0, 0, 1, 2, 3, 4, 0, 9, 9, 9};
+    fwrite(torn, 1, sizeof(torn), file);
+    fclose(file);
+    Fleet tornFleet(AVL);
+    bool recovered = journal.recover(tornFleet, snapshotPath, journalPath) && sameShips(reference, tornFleet);
+    journal.close();
+    file = fopen(journalPath, "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    recovered = recovered && ftell(file) == intact;
+    fclose(file);
+
+    // A compaction that crashed after restarting the journal is finished by
+    // recovery: the staged snapshot replaces the stale one
+    std::string staged = std::string(snapshotPath) + ".next";
+    std::rename(snapshotPath, staged.c_str());
+    Fleet(AVL).save(snapshotPath);
+    Fleet finished(AVL);
+    recovered = recovered && journal.recover(finished, snapshotPath, journalPath) && sameShips(reference, finished);
+    journal.close();
+    // With the snapshot gone the journal cannot be replayed, and is kept
+    std::remove(snapshotPath);
+    Fleet orphaned(AVL);
+    recovered = recovered && !journal.recover(orphaned, snapshotPath, journalPath);
+    file = fopen(journalPath, "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    recovered = recovered && ftell(file) == intact;
+    fclose(file);
+    std::remove(snapshotPath);
+    std::remove(journalPath);
+    return recovered;
+}
+
+bool Tester::testDumpAndExport() {
+    // Sink that keeps every chunk it is handed
+    struct Chunks : FleetSink {
+        ~Chunks() {flush();}
+        void write(const char* data, size_t length) {
+            text.append(data, length);
+            largest = std::max(largest, length);
+            calls++;
+        }
+        std::string text;
+        size_t largest = 0;
+        size_t calls = 0;
+    };
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        for (int i = 0; i < 5000; i++) {
+            int id = rand() % 20000 + MINID;
+            fleet.insert(Ship(id, static_cast<SHIPTYPE>(id % 5), (id % 3) ? ALIVE : LOST));
+        }
+        // The dump keeps the "(id:height)" nesting of the tree shape
+        std::string want;
+        if (types[t] == DENSE || types[t] == BTREE) {
+            for (Fleet::const_iterator it = fleet.begin(); it != fleet.end(); ++it)
+                want += "(" + std::to_string(it->getID()) + ":0)";
+        } else {
+            dumpRecursive(fleet.m_root, want);
+        }
+        std::ostringstream dumped;
+        fleet.dumpTree(dumped);
+        if (dumped.str() != want) return false;
+
+        Chunks csv, jsonl;
+        fleet.exportShips(csv, CSV);
+        fleet.exportShips(jsonl, JSONL);
+        csv.flush();
+        jsonl.flush();
+        if (csv.largest > FleetSink::CHUNK || csv.calls < 2) return false;
+        std::string wantCsv = "id,type,state\n", wantJsonl;
+        for (Fleet::const_iterator it = fleet.begin(); it != fleet.end(); ++it) {
+            std::string id = std::to_string(it->getID());
+            std::string type(it->getTypeStr()), state(it->getStateStr());
+            wantCsv += id + "," + type + "," + state + "\n";
+            wantJsonl += "{\"id\":" + id + ",\"type\":\"" + type + "\",\"state\":\"" + state + "\"}\n";
+        }
+        if (csv.text != wantCsv || jsonl.text != wantJsonl) return false;
+    }
+    return Ship(MINID, ROBOCARRIER, LOST).getTypeStr() == "ROBOCARRIER" && Ship(MINID).getStateStr() == "ALIVE";
+}
+
+bool Tester::testVersions() {
+    const TREETYPE types[] = {BST, AVL, SPLAY, DENSE, BTREE};
+    for (int t = 0; t < 5; t++) {
+        Fleet fleet(types[t]);
+        for (int i = 0; i < 4096; i++) fleet.insert(Ship(MINID + 2 * i, static_cast<SHIPTYPE>(i % 5)));
+        std::shared_ptr<const FleetVersion> version = fleet.snapshot();
+        std::map<int, int> kept; // ID to type as of the snapshot
+        fleet.forEachInRange(MINID, MAXID, [&kept](const Ship& ship) {kept[ship.getID()] = ship.getType();});
+        // The first change copies one root path, not the tree
+        size_t live = fleet.m_pool.live();
+        fleet.updateType(MINID + 2000, ROBOCARRIER);
+        if (types[t] != DENSE && types[t] != BTREE && fleet.m_pool.live() - live > size_t(fleet.m_root->getHeight()) + 2) return false;
+
+        // Readers of the version see none of the writer's changes
+        std::atomic<bool> done(false);
+        std::atomic<bool> intact(true);
+        std::thread reader([&version, &kept, &done, &intact]() {
+            while (!done) {
+                size_t seen = 0;
+                version->forEachInRange(MINID, MAXID, [&kept, &seen, &intact](const Ship& ship) {
+                    seen++;
+                    std::map<int, int>::const_iterator want = kept.find(ship.getID());
+                    if (want == kept.end() || want->second != ship.getType()) intact = false;
+                });
+                if (seen != kept.size() || !version->contains(MINID + 2000) || version->contains(MINID + 1)) intact = false;
+            }
+        });
+        for (int i = 0; i < 3000; i++) {
+            int id = MINID + rand() % 9000;
+            if (i % 3 == 0) fleet.insert(Ship(id));
+            else if (i % 3 == 1) fleet.remove(id);
+            else fleet.upsert(Ship(id, TELESCOPE, LOST));
+            if (i == 1500) fleet.insertMany(std::vector<Ship>(3000, Ship(MINID + 1)).data(), 3000); // Rebuilds
+        }
+        done = true;
+        reader.join();
+        if (!intact || version->size() != kept.size() || version->totals().ships != kept.size()) return false;
+        if (types[t] == AVL && !isBalanced(fleet.m_root)) return false;
+        if (types[t] != DENSE && types[t] != BTREE && !isBSTHelper(fleet.m_root, MINID, MAXID)) return false;
+
+        // Dropping the version frees its nodes on the next change
+        version.reset();
+        fleet.remove(MINID + 1);
+        if (types[t] != DENSE && types[t] != BTREE && fleet.m_pool.live() != fleet.size()) return false;
+    }
+    // A version outlives a cleared or destroyed fleet
+    std::shared_ptr<const FleetVersion> cleared, destroyed;
+    {
+        Fleet fleet(AVL);
+        for (int i = 0; i < 1000; i++) fleet.insert(Ship(MINID + i));
+        cleared = fleet.snapshot();
+        fleet.clear();
+        fleet.setType(AVL);
+        for (int i = 0; i < 10; i++) fleet.insert(Ship(MINID + i));
+        destroyed = fleet.snapshot();
+    }
+    return cleared->size() == 1000 && cleared->contains(MINID + 999) && destroyed->size() == 10;
+}
+
+bool Tester::testSetOperations() {
+    const TREETYPE types[] = {AVL, SPLAY, DENSE, BTREE};
+    for (int a = 0; a < 4; a++) {
+        for (int b = 0; b < 4; b++) {
+            for (int op = 0; op < 3; op++) {
+                // Large enough for the AVL pair to fork subtrees onto threads
+                Fleet mine(types[a]), theirs(types[b]);
+                std::map<int, int> mineRef, theirsRef; // ID to type
+                for (int i = 0; i < 40000; i++) {
+                    int id = MINID + rand() % 60000;
+                    SHIPTYPE type = static_cast<SHIPTYPE>(rand() % SHIPTYPES);
+                    mine.insert(Ship(id, type));
+                    mineRef.insert(std::make_pair(id, int(type)));
+                    id = MINID + rand() % 60000;
+                    theirs.insert(Ship(id, TELESCOPE));
+                    theirsRef.insert(std::make_pair(id, int(TELESCOPE)));
+                }
+                std::map<int, int> want;
+                if (op == 0) {
+                    want = mineRef;
+                    want.insert(theirsRef.begin(), theirsRef.end()); // Existing ships win
+                    mine.merge(theirs, 4);
+                } else {
+                    for (std::map<int, int>::const_iterator it = mineRef.begin(); it != mineRef.end(); ++it)
+                        if ((theirsRef.count(it->first) == 1) == (op == 1)) want.insert(*it);
+                    if (op == 1) mine.intersect(theirs, 4);
+                    else mine.difference(theirs, 4);
+                }
+                if (mine.size() != want.size() || theirs.size() != theirsRef.size()) return false;
+                std::map<int, int>::const_iterator expected = want.begin();
+                for (Fleet::const_iterator it = mine.begin(); it != mine.end(); ++it, ++expected)
+                    if (it->getID() != expected->first || it->getType() != expected->second) return false;
+                if (types[a] == AVL && !isBalanced(mine.m_root)) return false;
+                if (types[a] != DENSE && types[a] != BTREE && (!isBSTHelper(mine.m_root, MINID, MAXID) || mine.m_pool.live() != want.size()))
+                    return false;
+            }
+        }
+    }
+    // A fleet combined with itself
+    Fleet fleet(AVL);
+    for (int i = 0; i < 100; i++) fleet.insert(Ship(MINID + i));
+    fleet.merge(fleet);
+    fleet.intersect(fleet);
+    if (fleet.size() != 100) return false;
+    fleet.difference(fleet);
+    return fleet.size() == 0 && fleet.getType() == AVL;
+}
+
+
+// Tests the depth histogram against the nodes' own heights and the counters
+// against known operation sequences; without FLEET_STATS they stay zero
+bool Tester::testStats() {
+    Fleet list(BST);
+    for (int i = 0; i < 100; i++) list.insert(Ship(MINID + i));
+    FleetStats stats = list.stats();
+    if (stats.height != 99 || stats.depths.size() != 100) return false;
+    for (size_t d = 0; d < stats.depths.size(); d++)
+        if (stats.depths[d] != 1) return false;
+
+    Fleet avl(AVL), splay(SPLAY), dense(DENSE), btree(BTREE);
+    for (int i = 0; i < 1000; i++) {
+        avl.insert(Ship(MINID + i));
+        splay.insert(Ship(MINID + i));
+        dense.insert(Ship(MINID + i));
+        btree.insert(Ship(MINID + i));
+    }
+    stats = avl.stats();
+    size_t ships = 0;
+    for (size_t d = 0; d < stats.depths.size(); d++) ships += stats.depths[d];
+    if (stats.height != avl.m_root->m_height || ships != avl.size()) return false;
+    if (dense.stats().height != -1 || !dense.stats().depths.empty()) return false;
+    // Every BTREE ship sits in a leaf, one level per node level
+    stats = btree.stats();
+    if (stats.height < 1 || stats.height != btree.m_btree.height() - 1 || stats.depths.size() != size_t(stats.height) + 1 ||
+        stats.depths.back() != 1000 || stats.depths[0] != 0) return false;
+
+    avl.resetStats();
+    splay.resetStats();
+    avl.contains(MINID + 500);
+    splay.contains(MINID);
+    FleetStats avlStats = avl.stats(), splayStats = splay.stats();
+#ifdef FLEET_STATS
+    // Sorted inserts rotate at every power of two; a lookup in the list the
+    // sorted splay inserts left behind walks and splays the whole spine
+    Fleet sorted(AVL);
+    for (int i = 0; i < 1000; i++) sorted.insert(Ship(MINID + i));
+    if (sorted.stats().rotations == 0 || sorted.stats().allocations != 1000) return false;
+    if (avlStats.lookups != 1 || avlStats.lookupComparisons == 0 ||
+        avlStats.lookupComparisons > unsigned(avl.m_root->m_height + 1) || avlStats.rotations != 0)
+        return false;
+    if (splayStats.lookups != 1 || splayStats.splaySteps == 0 || splayStats.lookupComparisons < 999) return false;
+    splay.resetStats();
+    splay.contains(MINID);
+    return splay.stats().lookupComparisons <= 2 && splay.stats().allocations == 0;
+#else
+    return avlStats.lookups == 0 && avlStats.comparisons == 0 && splayStats.rotations == 0 &&
+           splayStats.splaySteps == 0 && avlStats.allocations == 0;
+#endif
+}
+
+// Height of an AVL engine subtree, or -2 if a height or balance is wrong
+static int checkAVLNodes(const AVLNode* node) {
+    if (!node) return -1;
+    int left = checkAVLNodes(node->left), right = checkAVLNodes(node->right);
+    if (left == -2 || right == -2 || left - right > 1 || right - left > 1) return -2;
+    int height = 1 + std::max(left, right);
+    return (node->height == height) ? height : -2;
+}
+
+// Runs random inserts, removes and lookups against a std::set and checks
+// the order after every round
+template <class Policy>
+static bool checkBasicFleet(BasicFleet<Policy>& fleet) {
+    std::set<int> reference;
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 2000; i++) {
+            int id = MINID + rand() % 5000;
+            int op = rand() % 3;
+            if (op == 0 && fleet.insert(Ship(id, CARGO, LOST)) != reference.insert(id).second) return false;
+            if (op == 1 && fleet.remove(id) != (reference.erase(id) == 1)) return false;
+            if (op == 2 && fleet.contains(id) != (reference.count(id) == 1)) return false;
+        }
+        if (fleet.insert(Ship(MINID - 1)) || fleet.size() != reference.size()) return false;
+        std::vector<int> ids;
+        bool payload = true;
+        fleet.forEach([&ids, &payload](const typename Policy::Node& node) {
+            ids.push_back(node.getID());
+            payload &= (node.getType() == CARGO && node.getState() == LOST);
+        });
+        if (!payload || ids != std::vector<int>(reference.begin(), reference.end())) return false;
+    }
+    fleet.clear();
+    return fleet.size() == 0 && !fleet.contains(MINID) && fleet.insert(Ship(MINID));
+}
+
+// Tests each compile-time engine against a reference set; the AVL engine
+// must also stay balanced through sorted inserts and random removals
+bool Tester::testBasicFleet() {
+    BasicFleet<BSTPolicy> bst;
+    BasicFleet<SplayPolicy> splay;
+    BasicFleet<AVLPolicy> avl;
+    if (!checkBasicFleet(bst) || !checkBasicFleet(splay) || !checkBasicFleet(avl)) return false;
+    if (sizeof(PlainNode) > 24 || sizeof(AVLNode) > 24) return false;
+    avl.clear();
+    for (int i = 0; i < 10000; i++) avl.insert(Ship(MINID + i));
+    if (checkAVLNodes(avl.root()) != 13) return false;
+    for (int i = 0; i < 10000; i += 1 + rand() % 3) avl.remove(MINID + i);
+    return checkAVLNodes(avl.root()) >= 0;
+}
+
+// Tests the BTREE layout against a std::map through node splits, borrows,
+// merges and root collapses, then its neighbour queries, order statistics,
+// totals and the conversions from and back to a tree
+bool Tester::testBTree() {
+    Fleet fleet(BTREE);
+    std::map<int, Ship> reference;
+    for (int round = 0; round < 2; round++) {
+        // Sorted inserts fill the rightmost leaves, random ones split anywhere
+        for (int i = 0; i < 20000; i++) {
+            int id = round ? rand() % 60000 + MINID : MINID + 3 * i;
+            Ship ship(id, static_cast<SHIPTYPE>(id % 5), (id % 3) ? ALIVE : LOST);
+            fleet.insert(ship);
+            reference.insert(std::make_pair(id, ship));
+        }
+        if (fleet.size() != reference.size() || fleet.m_btree.height() > 4) return false;
+        // Thin the fleet out until most nodes have to borrow or merge
+        for (int i = 0; i < 60000; i++) {
+            int id = rand() % 60000 + MINID;
+            if (fleet.contains(id) != (reference.count(id) == 1)) return false;
+            fleet.remove(id);
+            reference.erase(id);
+        }
+        if (fleet.size() != reference.size() || !fleet.m_btree.contains(reference.begin()->first)) return false;
+    }
+    size_t k = 0;
+    FleetTotals want = FleetTotals();
+    for (std::map<int, Ship>::iterator it = reference.begin(); it != reference.end(); ++it, k++) {
+        const Ship* found = fleet.find(it->first);
+        if (!found || found->getType() != it->second.getType() || found->getState() != it->second.getState()) return false;
+        if (fleet.rank(it->first) != k || fleet.select(k)->getID() != it->first) return false;
+        want.ships++;
+        want.byType[it->second.getType()]++;
+        want.byState[it->second.getState()]++;
+    }
+    FleetTotals totals = fleet.totals();
+    if (totals.ships != want.ships || totals.byState[LOST] != want.byState[LOST] || totals.byType[CARGO] != want.byType[CARGO])
+        return false;
+    for (int i = 0; i < 2000; i++) {
+        int id = rand() % 70000 + MINID - 5;
+        std::map<int, Ship>::iterator above = reference.lower_bound(id);
+        int next = above == reference.end() ? -1 : above->first;
+        int prev = above == reference.begin() ? -1 : (--std::map<int, Ship>::iterator(above))->first;
+        if (above != reference.end() && above->first == id) prev = id;
+        if (fleet.m_btree.next(id) != next || fleet.m_btree.prev(id) != prev) return false;
+        if (fleet.countInRange(id, id + 500) != size_t(std::distance(above, reference.upper_bound(id + 500)))) return false;
+    }
+
+    // The copy, the tree round trip and a rebuilt table all hold the same ships
+    Fleet copy(fleet);
+    fleet.setType(SPLAY);
+    if (fleet.m_btree.size() != 0 || !isBSTHelper(fleet.m_root, MINID, MAXID) || !sameShips(copy, fleet)) return false;
+    fleet.setType(DENSE);
+    fleet.setType(BTREE);
+    if (fleet.m_pool.live() != 0 || !sameShips(copy, fleet)) return false;
+    Fleet::const_iterator it = fleet.end();
+    for (std::map<int, Ship>::reverse_iterator want = reference.rbegin(); want != reference.rend(); ++want)
+        if ((--it)->getID() != want->first) return false;
+    fleet.clear();
+    return fleet.size() == 0 && fleet.m_btree.height() == 0 && fleet.begin() == fleet.end();
+}
+
+// Tests every type/state filter, ANY included, against a walk of the fleet
+// with both kernels, at sizes around the 64-row mask words; the columns
+// must be handed out again until the fleet changes
+bool Tester::testColumns() {
+    const size_t sizes[] = {0, 1, 63, 64, 65, 4000};
+    for (int kernel = 0; kernel < 2; kernel++) {
+        FleetColumns::vectorize(kernel == 0);
+        for (int n = 0; n < 6; n++) {
+            Fleet fleet(n % 2 ? AVL : BTREE);
+            while (fleet.size() < sizes[n])
+                fleet.insert(Ship(rand() % 10000 + MINID, static_cast<SHIPTYPE>(rand() % 5), (rand() % 3) ? ALIVE : LOST));
+            std::shared_ptr<const FleetColumns> columns = fleet.columns();
+            if (columns->size() != fleet.size()) return false;
+            for (int type = FleetColumns::ANY; type < SHIPTYPES; type++) {
+                for (int state = FleetColumns::ANY; state < 2; state++) {
+                    std::vector<int> want;
+                    std::vector<uint64_t> wantBits((fleet.size() + 63) / 64, 0);
+                    size_t row = 0;
+                    for (Fleet::const_iterator it = fleet.begin(); it != fleet.end(); ++it, row++) {
+                        if ((type != FleetColumns::ANY && it->getType() != type) || (state != FleetColumns::ANY && it->getState() != state))
+                            continue;
+                        want.push_back(it->getID());
+                        wantBits[row / 64] |= uint64_t(1) << (row % 64);
+                    }
+                    std::vector<int> ids(1, -1); // select appends
+                    std::vector<uint64_t> bits;
+                    if (columns->count(type, state) != want.size() || columns->select(type, state, ids) != want.size()) return false;
+                    if (columns->mask(type, state, bits) != want.size() || bits != wantBits) return false;
+                    if (ids[0] != -1 || !std::equal(want.begin(), want.end(), ids.begin() + 1)) return false;
+                }
+            }
+            if (columns->count(SHIPTYPES, ALIVE) != 0 || columns->count(CARGO, 2) != 0) return false;
+            if (fleet.size() == 0) continue;
+            // Unchanged fleets share their columns, a type change rebuilds them
+            if (fleet.columns() != columns) return false;
+            int id = columns->ids()[0];
+            fleet.updateType(id, columns->type(0) == CARGO ? TELESCOPE : CARGO);
+            std::shared_ptr<const FleetColumns> rebuilt = fleet.columns();
+            if (rebuilt == columns || rebuilt->type(0) == columns->type(0) || rebuilt->ids()[0] != id) return false;
+        }
+    }
+    FleetColumns::vectorize(true);
+    return true;
+}
+
 int main() {
     Tester tester;
     // Run and display results for various test cases
@@ -130,6 +1290,32 @@ int main() {
     std::cout << "Test if BST remove works for a normal case: " << (tester.testBSTRemoveNormalCase() ? "Passed" : "Failed") << std::endl;
     std::cout << "Test if BST remove works for an edge case: " << (tester.testBSTRemoveEdgeCase() ? "Passed" : "Failed") << std::endl;
     std::cout << "Test if AVL tree is balanced after removals: " << (tester.testAVLRemove() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if the ship pool recycles removed nodes: " << (tester.testPoolRecycling() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if inserts reject duplicate IDs: " << (tester.testInsertDuplicates() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if a degenerate BST is handled without recursion: " << (tester.testSortedBSTDepth() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if find and findMany agree across tree types: " << (tester.testFindAndFindMany() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if the DENSE table converts to and from trees: " << (tester.testDenseType() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if bulk loading builds a balanced tree: " << (tester.testBulkLoad() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if the compact store matches an AVL fleet: " << (tester.testCompactFleet() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if snapshots match the fleet and rebuild lazily: " << (tester.testSnapshotPublish() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if concurrent readers run safely beside a writer: " << (tester.testConcurrentReaders() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if sharded batches and range scans match a plain fleet: " << (tester.testShardedFleet() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if sharded batches from two threads all land: " << (tester.testShardedConcurrentBatches() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if iterators and range scans visit ships in ID order: " << (tester.testIterators() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if range scans starting above every ship visit nothing: " << (tester.testRangeAboveAll() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if rank, select and range counts match the ship order: " << (tester.testOrderStatistics() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if type and state totals match a full count: " << (tester.testTotals() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if batched updates match applying events one by one: " << (tester.testApplyUpdates() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if in-place updates change ships without relinking them: " << (tester.testInPlaceUpdates() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if saved fleets load and map back unchanged: " << (tester.testSaveLoad() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if journaled changes survive a restart and compaction: " << (tester.testJournal() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if dumps and exports stream every ship in order: " << (tester.testDumpAndExport() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if versions stay unchanged and are reclaimed when dropped: " << (tester.testVersions() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if merge, intersect and difference match set arithmetic: " << (tester.testSetOperations() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if stats count operations and measure the tree shape: " << (tester.testStats() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if the compile-time engines match a reference set: " << (tester.testBasicFleet() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if the BTREE layout matches a reference map: " << (tester.testBTree() ? "Passed" : "Failed") << std::endl;
+    std::cout << "Test if column filters match a walk of the fleet: " << (tester.testColumns() ? "Passed" : "Failed") << std::endl;
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "fleet_version.h"
+
+// Queues the root; the count drops last so that a writer seeing no live
+// versions also sees the queued root
+FleetVersion::~FleetVersion() {
+    if (m_root) {
+        std::lock_guard<std::mutex> guard(m_state->lock);
+        m_state->graveyard.push_back(const_cast<Ship*>(m_root));
+        m_state->pending = true;
+    }
+    m_state->live--;
+}
+
+// Plain descent, versions never splay
+const Ship* FleetVersion::find(int id) const {
+    const Ship* node = m_root;
+    while (node && node->getID() != id)
+        node = (id < node->getID()) ? node->getLeft() : node->getRight();
+    return node;
+}
+
+// Totals read off the root's subtree counts
+FleetTotals FleetVersion::totals() const {
+    FleetTotals totals = FleetTotals();
+    if (!m_root) return totals;
+    totals.ships = m_root->getSize();
+    for (int type = 0; type < SHIPTYPES; type++) totals.byType[type] = m_root->getTypeCount(static_cast<SHIPTYPE>(type));
+    totals.byState[LOST] = m_root->getLostCount();
+    totals.byState[ALIVE] = totals.ships - totals.byState[LOST];
+    return totals;
+}
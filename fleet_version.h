@@ -0,0 +1,42 @@
+#ifndef FLEET_VERSION_H
+#define FLEET_VERSION_H
+#include "fleet.h"
+#include <atomic>
+#include <mutex>
+
+// State shared by a fleet and the versions it handed out. Versions may be
+// dropped on any thread, so they only queue their roots in the graveyard;
+// the fleet's writer releases the nodes during its next change.
+struct FleetVersionState{
+    FleetVersionState() : live(0), pending(false) {}
+    std::mutex lock;                // guards the graveyard
+    vector<Ship*> graveyard;        // roots of dropped versions
+    std::atomic<size_t> live;       // versions not dropped yet
+    std::atomic<bool> pending;      // the graveyard holds roots
+    ShipPool retired;               // nodes of a fleet cleared or destroyed under live versions
+};
+
+// Read-only view of a fleet as it was when Fleet::snapshot() returned it.
+// Its nodes are never changed while it exists, so any number of threads may
+// read it while the fleet's writer goes on; it stays valid even after the
+// fleet is cleared or destroyed.
+class FleetVersion{
+    public:
+    ~FleetVersion();    // hands the root back to the writer for reclamation
+    size_t size() const {return m_root ? m_root->getSize() : 0;}
+    const Ship* find(int id) const;
+    bool contains(int id) const {return find(id) != nullptr;}
+    FleetTotals totals() const;
+    //calls fn(const Ship&) for every ship with lo <= ID <= hi in ID order
+    template <class Fn>
+    void forEachInRange(int lo, int hi, Fn fn) const {Fleet::forEachInSubtree(m_root, lo, hi, fn);}
+    private:
+    friend class Fleet;
+    FleetVersion(const Ship* root, const std::shared_ptr<FleetVersionState>& state)
+        : m_root(root), m_state(state) {}
+    FleetVersion(const FleetVersion&);
+    FleetVersion& operator=(const FleetVersion&);
+    const Ship* m_root;
+    std::shared_ptr<FleetVersionState> m_state;
+};
+#endif
@@ -0,0 +1,319 @@
+#include "fleet.h"
+#include "fleet_random.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+using namespace std;
+
+// Workload benchmark comparing the tree types under repeatable access
+// patterns. Every run preloads a fleet, then replays an operation sequence
+// generated up front from fixed seeds: once untimed per operation for the
+// throughput, once on a fresh fleet with every operation timed for the
+// latency percentiles. Results go out as a table, CSV or JSON lines.
+//
+//   ./workload [--types=bst,avl,splay] [--workloads=uniform,zipf,sorted,window]
+//              [--mixes=read,write] [--sizes=1000,10000,90000] [--ops=200000]
+//              [--seed=10] [--format=table|csv|json]
+//
+// A mix is "read" (95% lookups), "write" (20% lookups) or a lookup percentage.
+
+enum WORKLOAD {UNIFORM, ZIPF, SORTED, WINDOW};
+enum OPKIND {LOOKUP, ADD, DROP};
+
+struct Operation {
+    OPKIND kind;
+    int id;
+};
+
+struct Run {
+    TREETYPE type;
+    WORKLOAD workload;
+    int reads;      // lookup percentage
+    int ships;
+    int ops;
+};
+
+struct Result {
+    double meanNs, p50Ns, p90Ns, p99Ns, p999Ns, maxNs;
+    double opsPerSec;
+    long rssKB;     // resident set after the timed pass
+};
+
+static const char* TYPE_NAMES[] = {"none", "bst", "avl", "splay", "dense", "btree"};
+static const char* WORKLOAD_NAMES[] = {"uniform", "zipf", "sorted", "window"};
+static const int UNIVERSE = MAXID - MINID + 1;
+// BST runs of the ordered workloads grow a list, so they are kept this small
+static const int DEGENERATE_SHIPS = 10000;
+static const int DEGENERATE_OPS = 20000;
+// Skew of the Zipfian key popularity
+static const double ZIPF_EXPONENT = 0.99;
+
+// Current resident set size from /proc, 0 where it is not available
+static long residentKB() {
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Draws key ranks with probability proportional to 1/(rank+1)^s from a
+// cumulative table searched by bisection
+class Zipf {
+public:
+    Zipf(int n, Random& uniform) : m_uniform(uniform) {
+        m_cdf.resize(n);
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += 1.0 / pow(i + 1.0, ZIPF_EXPONENT);
+            m_cdf[i] = sum;
+        }
+        for (int i = 0; i < n; i++) m_cdf[i] /= sum;
+    }
+    int next() {
+        double u = (m_uniform.getRandNum() + 0.5) / (m_uniform.getMax() + 1.0);
+        return std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin();
+    }
+private:
+    Random& m_uniform;
+    vector<double> m_cdf;
+};
+
+// Builds the preload order and the operation sequence of a run. Writes
+// alternate between dropping and adding so the fleet size stays put: the
+// uniform, Zipfian and sorted workloads add the dropped key back, the window
+// drops its oldest ID and adds the next one past its newest.
+static void generate(const Run& run, unsigned seed, vector<int>& preload, vector<Operation>& ops) {
+    Random shuffler(0, UNIVERSE - 1, SHUFFLE);
+    shuffler.setSeed(seed);
+    Random uniform(0, (1 << 30) - 1);
+    uniform.setSeed(seed + 1);
+    Random percent(0, 99);
+    percent.setSeed(seed + 2);
+
+    // Keys of the run in popularity or access order
+    vector<int> offsets;
+    shuffler.getShuffle(offsets);
+    vector<int> keys(run.ships);
+    if (run.workload == UNIFORM || run.workload == ZIPF) {
+        for (int i = 0; i < run.ships; i++) keys[i] = MINID + offsets[i];
+        preload = keys;
+    } else {
+        // Consecutive IDs from a random start, wrapping around the ID range
+        int start = offsets[0];
+        for (int i = 0; i < run.ships; i++) keys[i] = MINID + (start + i) % UNIVERSE;
+        preload = keys;
+        if (run.workload == WINDOW) {
+            // The window is already in place, its IDs arrived in any order
+            vector<int> order;
+            Random arrival(0, run.ships - 1, SHUFFLE);
+            arrival.setSeed(seed + 3);
+            arrival.getShuffle(order);
+            for (int i = 0; i < run.ships; i++) preload[i] = keys[order[i]];
+        }
+    }
+
+    Zipf zipf(run.workload == ZIPF ? run.ships : 1, uniform);
+    ops.clear();
+    ops.reserve(run.ops);
+    int cursor = 0;                 // next key of the sorted scan
+    int oldest = 0;                 // window offset of the oldest ID
+    bool dropped = false;           // a write pair is half done
+    int droppedID = 0;
+    for (int i = 0; i < run.ops; i++) {
+        bool lookup = percent.getRandNum() < run.reads;
+        int id = 0;
+        if (run.workload == UNIFORM) id = keys[uniform.getRandNum() % run.ships];
+        else if (run.workload == ZIPF) id = keys[zipf.next()];
+        else if (run.workload == SORTED) id = keys[cursor++ % run.ships];
+        else id = MINID + (keys[0] - MINID + oldest + uniform.getRandNum() % run.ships) % UNIVERSE;
+
+        Operation op = {LOOKUP, id};
+        if (!lookup && dropped) {
+            op.kind = ADD;
+            op.id = (run.workload == WINDOW) ? MINID + (keys[0] - MINID + oldest - 1 + run.ships) % UNIVERSE : droppedID;
+            dropped = false;
+        } else if (!lookup) {
+            op.kind = DROP;
+            if (run.workload == WINDOW) op.id = MINID + (keys[0] - MINID + oldest++) % UNIVERSE;
+            droppedID = op.id;
+            dropped = true;
+        }
+        ops.push_back(op);
+    }
+}
+
+static Fleet* preloaded(TREETYPE type, const vector<int>& preload) {
+    Fleet* fleet = new Fleet(type);
+    for (size_t i = 0; i < preload.size(); i++) fleet->insert(Ship(preload[i]));
+    return fleet;
+}
+
+static inline void execute(Fleet& fleet, const Operation& op, long& found) {
+    if (op.kind == LOOKUP) found += fleet.contains(op.id);
+    else if (op.kind == ADD) fleet.insert(Ship(op.id));
+    else fleet.remove(op.id);
+}
+
+// Cost of reading the clock twice, taken off every timed operation
+static double clockOverheadNs() {
+    vector<double> samples(10001);
+    for (size_t i = 0; i < samples.size(); i++) {
+        auto start = std::chrono::steady_clock::now();
+        auto stop = std::chrono::steady_clock::now();
+        samples[i] = std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+static double percentile(vector<double>& samples, double fraction) {
+    size_t k = std::min(samples.size() - 1, size_t(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+static Result measure(const Run& run, unsigned seed, double overheadNs) {
+    vector<int> preload;
+    vector<Operation> ops;
+    generate(run, seed, preload, ops);
+    Result result;
+    long found = 0;
+
+    Fleet* fleet = preloaded(run.type, preload);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops.size(); i++) execute(*fleet, ops[i], found);
+    double totalNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    result.opsPerSec = ops.size() / (totalNs / 1e9);
+    delete fleet;
+
+    fleet = preloaded(run.type, preload);
+    vector<double> samples(ops.size());
+    double sum = 0;
+    for (size_t i = 0; i < ops.size(); i++) {
+        auto before = std::chrono::steady_clock::now();
+        execute(*fleet, ops[i], found);
+        auto after = std::chrono::steady_clock::now();
+        samples[i] = std::max(0.0, std::chrono::duration<double, std::nano>(after - before).count() - overheadNs);
+        sum += samples[i];
+    }
+    result.rssKB = residentKB();
+    delete fleet;
+    if (found < 0) cerr << found; // Keeps the lookups alive
+
+    result.meanNs = sum / samples.size();
+    result.p50Ns = percentile(samples, 0.50);
+    result.p90Ns = percentile(samples, 0.90);
+    result.p99Ns = percentile(samples, 0.99);
+    result.p999Ns = percentile(samples, 0.999);
+    result.maxNs = *std::max_element(samples.begin(), samples.end());
+    return result;
+}
+
+// Splits a comma separated option value
+static vector<string> split(const string& list) {
+    vector<string> items;
+    std::stringstream stream(list);
+    string item;
+    while (std::getline(stream, item, ',')) if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+static int indexOf(const char* const names[], int count, const string& name) {
+    for (int i = 0; i < count; i++)
+        if (name == names[i]) return i;
+    return -1;
+}
+
+static void usage(const char* program) {
+    cerr << "usage: " << program << " [--types=bst,avl,splay,dense,btree] [--workloads=uniform,zipf,sorted,window]"
+         << " [--mixes=read,write,<lookup %>] [--sizes=1000,...] [--ops=N] [--seed=N] [--format=table|csv|json]" << endl;
+}
+
+int main(int argc, char** argv) {
+    vector<string> types = {"bst", "avl", "splay"};
+    vector<string> workloads = {"uniform", "zipf", "sorted", "window"};
+    vector<string> mixes = {"read", "write"};
+    vector<string> sizes = {"1000", "10000", "90000"};
+    int opCount = 200000;
+    unsigned seed = 10;
+    string format = "table";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals), value = (equals == string::npos) ? "" : arg.substr(equals + 1);
+        if (name == "--types") types = split(value);
+        else if (name == "--workloads") workloads = split(value);
+        else if (name == "--mixes") mixes = split(value);
+        else if (name == "--sizes") sizes = split(value);
+        else if (name == "--ops") opCount = atoi(value.c_str());
+        else if (name == "--seed") seed = strtoul(value.c_str(), nullptr, 10);
+        else if (name == "--format" && (value == "table" || value == "csv" || value == "json")) format = value;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<Run> runs;
+    for (const string& type : types) {
+        for (const string& workload : workloads) {
+            for (const string& mix : mixes) {
+                for (const string& size : sizes) {
+                    Run run;
+                    int typeIndex = indexOf(TYPE_NAMES, 6, type);
+                    int workloadIndex = indexOf(WORKLOAD_NAMES, 4, workload);
+                    run.reads = (mix == "read") ? 95 : (mix == "write") ? 20 : atoi(mix.c_str());
+                    run.ships = atoi(size.c_str());
+                    run.ops = opCount;
+                    if (typeIndex <= 0 || workloadIndex < 0 || run.reads < 0 || run.reads > 100 ||
+                        run.ships < 1 || run.ships > UNIVERSE || run.ops < 1) {
+                        usage(argv[0]);
+                        return 1;
+                    }
+                    run.type = static_cast<TREETYPE>(typeIndex);
+                    run.workload = static_cast<WORKLOAD>(workloadIndex);
+                    if (run.type == BST && (run.workload == SORTED || run.workload == WINDOW)) {
+                        if (run.ships > DEGENERATE_SHIPS) continue;
+                        run.ops = std::min(run.ops, DEGENERATE_OPS);
+                    }
+                    runs.push_back(run);
+                }
+            }
+        }
+    }
+
+    double overheadNs = clockOverheadNs();
+    if (format == "csv")
+        cout << "type,workload,reads,ships,ops,seed,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,ops_per_sec,rss_kb" << endl;
+    else if (format == "table")
+        cout << "Workloads, ns/op after " << overheadNs << " ns clock overhead; seed " << seed << endl
+             << "type   workload reads  ships    ops     mean    p50    p90    p99  p99.9      max     Mops/s  RSS KB" << endl;
+    for (const Run& run : runs) {
+        Result r = measure(run, seed, overheadNs);
+        const char* type = TYPE_NAMES[run.type];
+        const char* workload = WORKLOAD_NAMES[run.workload];
+        char line[256];
+        if (format == "csv") {
+            snprintf(line, sizeof(line), "%s,%s,%d,%d,%d,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.0f,%ld", type, workload,
+                     run.reads, run.ships, run.ops, seed, r.meanNs, r.p50Ns, r.p90Ns, r.p99Ns, r.p999Ns, r.maxNs,
+                     r.opsPerSec, r.rssKB);
+        } else if (format == "json") {
+            snprintf(line, sizeof(line),
+                     "{\"type\":\"%s\",\"workload\":\"%s\",\"reads\":%d,\"ships\":%d,\"ops\":%d,\"seed\":%u,"
+                     "\"mean_ns\":%.1f,\"p50_ns\":%.1f,\"p90_ns\":%.1f,\"p99_ns\":%.1f,\"p999_ns\":%.1f,"
+                     "\"max_ns\":%.1f,\"ops_per_sec\":%.0f,\"rss_kb\":%ld}",
+                     type, workload, run.reads, run.ships, run.ops, seed, r.meanNs, r.p50Ns, r.p90Ns, r.p99Ns,
+                     r.p999Ns, r.maxNs, r.opsPerSec, r.rssKB);
+        } else {
+            snprintf(line, sizeof(line), "%-6s %-8s %5d %6d %6d %8.1f %6.0f %6.0f %6.0f %6.0f %8.0f %10.2f %7ld", type,
+                     workload, run.reads, run.ships, run.ops, r.meanNs, r.p50Ns, r.p90Ns, r.p99Ns, r.p999Ns, r.maxNs,
+                     r.opsPerSec / 1e6, r.rssKB);
+        }
+        cout << line << endl;
+    }
+    return 0;
+}